@@ -0,0 +1,244 @@
+#include "scanner.h"
+#include "regex/regex.h"
+#include "char_scan.h"
+#include "bench_util.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Micro-benchmarks of the regex library and the scanner, the results are printed to `stdout`
+// as one json object. Each measurement is the best of `REPEAT` runs (see bench_util.h).
+using namespace DRCC;
+
+namespace
+{
+
+/// @brief the size of the synthetic inputs in bytes
+constexpr size_t INPUT_SIZE = 4 << 20;
+
+/// @brief the states of the lambda chain timed by `bench_compile`
+constexpr int LAMBDA_CHAIN_SIZE = 200000;
+
+/// @brief repeat words picked by `next` until the input is `INPUT_SIZE` bytes long
+std::string synthesize(const std::function<std::string(int)> & next)
+{
+    std::string input;
+    input.reserve(INPUT_SIZE + 64);
+    for(int i = 0; input.size() < INPUT_SIZE; i++)
+    {
+        input += next(i);
+    }
+    return input;
+}
+
+/// @brief identifiers and keywords separated by single blanks
+std::string identifier_heavy()
+{
+    static const char * words[] = { "counter", "i", "while", "buffer_size", "tmp2", "int", "value_of_x", "printf" };
+    return synthesize([](int i) { return std::string(words[i % 8]) + (i % 10 == 9 ? ";\n" : " "); });
+}
+
+/// @brief decimal and hexadecimal literals in expressions
+std::string number_heavy()
+{
+    return synthesize([](int i) {
+        return std::to_string(i * 7919 % 1000003) + (i % 3 ? " + " : " * 0x1f") + (i % 8 == 7 ? ";\n" : " ");
+    });
+}
+
+/// @brief deeply indented short statements, like generated sources
+std::string whitespace_heavy()
+{
+    return synthesize([](int i) { return std::string(4 * (i % 12) + 1, ' ') + (i % 2 ? "x = y;\n" : "\t\t{ }\n"); });
+}
+
+/// @brief the patterns timed one by one
+struct Pattern
+{
+    const char * name;
+    const char * pattern;
+};
+
+const Pattern patterns[] = {
+    { "keyword", "while" },
+    { "identifier", "[a-zA-Z][a-zA-Z0-9_]*" },
+    { "integer", "[0-9]+|0x[0-9a-f]+" },
+    { "operators", "<<|>>|<=|>=|==|!=|&&|\\|\\||[-+*/%&|!=<>{}\\[\\]();,]" },
+    { "nth_from_end", "[ab]*a[ab]{7}" },
+};
+
+JsonObject bench_compile(const char * cache_path)
+{
+    JsonObject result;
+    for(const Pattern & pat : patterns)
+    {
+        Regex::NFABuilder builder;
+        Regex::NFABuilder::Fragment frag;
+        if(! builder.parse(pat.pattern, frag))
+        {
+            std::cerr << "bench_lex: " << builder.error() << std::endl;
+            std::exit(1);
+        }
+        const FSM::NFA nfa = builder.build(frag);
+
+        FSM::NFA built(nfa);
+        built.build();
+        FSM::DFA dfa(built);
+        dfa.build();
+
+        double nfa_build = best_of([&]() { FSM::NFA copy(nfa); copy.build(); });
+        double dfa_build = best_of([&]() { FSM::DFA copy(built); copy.build(); });
+        double regex_compile = best_of([&]() { Regex::RegexPatObj regex(nfa); regex.compile(); });
+
+        result.field(pat.name, JsonObject()
+            .field("pattern", pat.pattern)
+            .field("nfa_states", nfa.size())
+            .field("dfa_states", dfa.size())
+            .field("nfa_build_us", nfa_build * 1e6)
+            .field("dfa_build_us", dfa_build * 1e6)
+            .field("regex_compile_us", regex_compile * 1e6));
+    }
+
+    // a long lambda chain, each closure holds the states after it: checked, as a closure
+    // copied into the one before it would make the build quadratic
+    FSM::NFA chain(LAMBDA_CHAIN_SIZE);
+    for(int state = 0; state + 1 < LAMBDA_CHAIN_SIZE; state++)
+    {
+        chain.add_transition(state, '\0', state + 1);
+    }
+    chain.add_accept_state(LAMBDA_CHAIN_SIZE - 1);
+
+    FSM::NFA built_chain(chain);
+    built_chain.build();
+    std::vector<int> closure;
+    built_chain.lambda_closure(0, closure);
+    if(static_cast<int>(closure.size()) != LAMBDA_CHAIN_SIZE || ! built_chain.is_accept_state(0))
+    {
+        std::cerr << "bench_lex: wrong closure of the lambda chain" << std::endl;
+        std::exit(1);
+    }
+
+    result.field("lambda_chain", JsonObject()
+        .field("nfa_states", LAMBDA_CHAIN_SIZE)
+        .field("nfa_build_ms", best_of([&]() { FSM::NFA copy(chain); copy.build(); }) * 1e3));
+
+    // the full token set, without and with the cache file
+    setenv("DRCC_TOKEN_CACHE", "", 1);
+    double cold = best_of([]() { Scanner scanner{std::string()}; });
+    setenv("DRCC_TOKEN_CACHE", cache_path, 1);
+    Scanner warm_up{std::string()};
+    double warm = best_of([]() { Scanner scanner{std::string()}; });
+
+    result.field("scanner_init", JsonObject()
+        .field("uncached_ms", cold * 1e3)
+        .field("cached_ms", warm * 1e3));
+    return result;
+}
+
+JsonObject bench_match(const std::string & input)
+{
+    Regex::NFABuilder builder;
+    Regex::NFABuilder::Fragment frag;
+    builder.parse("[a-zA-Z_][a-zA-Z0-9_]*", frag);
+    FSM::NFA nfa = builder.build(frag);
+    nfa.build();
+
+    FSM::DFA dfa(nfa);
+    dfa.build();
+    FSM::LazyDFA lazy_dfa(nfa);
+    lazy_dfa.build();
+    FSM::BitParallelNFA bit_nfa;
+    bit_nfa.build(nfa);
+
+    // the anchored matcher at each offset where the previous match ended
+    auto scan = [&](const std::function<int(const char *, int)> & match) {
+        size_t pos = 0;
+        while(pos < input.size())
+        {
+            int len = match(input.c_str() + pos, input.size() - pos);
+            pos += len > 0 ? len : 1;
+        }
+    };
+
+    JsonObject result;
+    result.field("dfa_mb_s", input.size() / 1e6 / best_of([&]() {
+        scan([&](const char * str, int length) { return dfa.max_accept_length(str, length); });
+    }));
+    result.field("lazy_dfa_mb_s", input.size() / 1e6 / best_of([&]() {
+        scan([&](const char * str, int length) { return lazy_dfa.max_accept_length(str, length); });
+    }));
+    result.field("bit_parallel_mb_s", input.size() / 1e6 / best_of([&]() {
+        scan([&](const char * str, int length) { return bit_nfa.max_accept_length(str, length); });
+    }));
+
+    // unanchored search for a rare literal
+    Regex::RegexPatObj rare("");
+    Regex::RegexParse("0x1f[0-9]*", rare);
+    rare.compile();
+    result.field("find_all_mb_s", input.size() / 1e6 / best_of([&]() { rare.find_all(input.c_str(), input.size()); }));
+    return result;
+}
+
+JsonObject bench_scanner(const std::string & input)
+{
+    size_t num_tokens = 0;
+    double time = best_of([&]() {
+        Scanner scanner(input);
+        num_tokens = 0;
+        while(scanner.next_token().token_type != END)
+        {
+            num_tokens++;
+        }
+    });
+
+    // the construction (a cached init and a copy of the input) is part of the time
+    return JsonObject()
+        .field("tokens", num_tokens)
+        .field("mb_s", input.size() / 1e6 / time)
+        .field("tokens_per_s", num_tokens / time);
+}
+
+}
+
+int main()
+{
+    const std::string inputs[] = { identifier_heavy(), number_heavy(), whitespace_heavy() };
+    const char * input_names[] = { "identifier_heavy", "number_heavy", "whitespace_heavy" };
+
+    // a private cache file, so that runs do not depend on the cache of the compiler
+    char cache_path[] = "/tmp/drcc-bench-XXXXXX";
+    int fd = mkstemp(cache_path);
+    if(fd < 0)
+    {
+        std::cerr << "bench_lex: cannot create a cache file" << std::endl;
+        return 1;
+    }
+    close(fd);
+
+    JsonObject compile = bench_compile(cache_path);
+
+    JsonObject match, scanner;
+    for(int i = 0; i < 3; i++)
+    {
+        match.field(input_names[i], bench_match(inputs[i]));
+        scanner.field(input_names[i], bench_scanner(inputs[i]));
+    }
+
+    std::cout << JsonObject()
+        .field("input_bytes", INPUT_SIZE)
+        .field("char_scan_isa", char_scan_isa())
+        .field("compile", compile)
+        .field("match", match)
+        .field("scanner", scanner)
+        .str() << std::endl;
+
+    std::remove(cache_path);
+    return 0;
+}
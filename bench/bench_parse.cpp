@@ -0,0 +1,96 @@
+#include "parser.h"
+#include "bench_util.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Micro-benchmark of the LR parse loop, the results are printed to `stdout` as one json
+// object. `Parser::parse` pulls its tokens from the scanner, so the timed parse includes
+// the scanning: the time of scanning the same input alone is measured separately and
+// subtracted, `parse_ms` and `parse_tokens_per_s` are estimates of the parse loop alone.
+using namespace DRCC;
+
+namespace
+{
+
+/// @brief the number of statement groups in the synthetic program
+constexpr int NUM_GROUPS = 20000;
+
+/// @brief a valid program exercising most of the grammar
+std::string synthesize_program()
+{
+    std::string program = "int a, b = 3, c[10];\n";
+    for(int i = 0; i < NUM_GROUPS; i++)
+    {
+        program += "a = a + b * 3 - (c[2] << 1);\n"
+            "if (a < b) { b = b + 1; } else { a = a - 1; }\n"
+            "while (a > 100) { a = a / 2; }\n"
+            "do { c[a % 10] = !a && b || 0x1f; } while (a >= 5);\n"
+            "printf(a);\n";
+    }
+    return program;
+}
+
+}
+
+int main()
+{
+    const std::string program = synthesize_program();
+
+    size_t num_tokens = 0;
+    {
+        Scanner scanner(program);
+        while(scanner.next_token().token_type != END)
+        {
+            num_tokens++;
+        }
+    }
+
+    // the parser consumes its scanner: a new one is built, untimed, for each run
+    double total = 1e30;
+    for(int i = 0; i < REPEAT; i++)
+    {
+        Parser parser(std::make_unique<Scanner>(program));
+        auto begin = std::chrono::steady_clock::now();
+        std::shared_ptr<ASTNode> root = parser.parse();
+        auto end = std::chrono::steady_clock::now();
+        total = std::min(total, std::chrono::duration<double>(end - begin).count());
+
+        // the tree is freed outside of the timing
+        if(root == nullptr)
+        {
+            std::cerr << "bench_parse: syntax error" << std::endl;
+            return 1;
+        }
+    }
+
+    double construct = best_of([]() { Parser parser(std::make_unique<Scanner>(std::string())); });
+
+    // the scanner is built untimed too, like the one of the parser
+    double scan = 1e30;
+    for(int i = 0; i < REPEAT; i++)
+    {
+        Scanner scanner(program);
+        auto begin = std::chrono::steady_clock::now();
+        while(scanner.next_token().token_type != END)
+        {
+        }
+        auto end = std::chrono::steady_clock::now();
+        scan = std::min(scan, std::chrono::duration<double>(end - begin).count());
+    }
+
+    // the parse loop alone, without the scanning it drives
+    const double parse = std::max(total - scan, 1e-9);
+    std::cout << JsonObject()
+        .field("input_bytes", program.size())
+        .field("tokens", num_tokens)
+        .field("table_construction_ms", construct * 1e3)
+        .field("scan_ms", scan * 1e3)
+        .field("parse_ms", parse * 1e3)
+        .field("parse_tokens_per_s", num_tokens / parse)
+        .str() << std::endl;
+    return 0;
+}
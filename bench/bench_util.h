@@ -0,0 +1,92 @@
+#ifndef DRCC_BENCH_UTIL_H
+#define DRCC_BENCH_UTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+// The timing and the json output shared by the benchmarks
+namespace
+{
+
+constexpr int REPEAT = 5;
+
+/// @brief the best wall time of `REPEAT` runs of `fn`, in seconds
+double best_of(const std::function<void()> & fn)
+{
+    double best = 1e30;
+    for(int i = 0; i < REPEAT; i++)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - begin).count());
+    }
+    return best;
+}
+
+/// @brief a json object under construction, fields are appended in order
+class JsonObject
+{
+public:
+
+    JsonObject & field(const std::string & key, double value)
+    {
+        std::ostringstream oss;
+        oss.precision(6);
+        oss << value;
+        return raw(key, oss.str());
+    }
+
+    template<typename T>
+    std::enable_if_t<std::is_integral<T>::value, JsonObject &> field(const std::string & key, T value)
+    {
+        return raw(key, std::to_string(value));
+    }
+
+    JsonObject & field(const std::string & key, const std::string & value)
+    {
+        std::string quoted = "\"";
+        for(char ch : value)
+        {
+            if(ch == '"' || ch == '\\')
+            {
+                quoted.push_back('\\');
+            }
+            quoted.push_back(ch);
+        }
+        return raw(key, quoted + "\"");
+    }
+
+    JsonObject & field(const std::string & key, const char * value)
+    {
+        return field(key, std::string(value));
+    }
+
+    JsonObject & field(const std::string & key, const JsonObject & value)
+    {
+        return raw(key, value.str());
+    }
+
+    JsonObject & raw(const std::string & key, const std::string & value)
+    {
+        body_ += (body_.empty() ? "" : ", ") + ("\"" + key + "\": ") + value;
+        return *this;
+    }
+
+    std::string str() const
+    {
+        return "{" + body_ + "}";
+    }
+
+private:
+
+    std::string body_;
+};
+
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef DRCC_CHAR_SCAN_H
+#define DRCC_CHAR_SCAN_H
+
+#include <cstddef>
+
+namespace DRCC
+{
+
+/// @brief the length of the run of whitespace (' ', '\t', '\n', '\v', '\f', '\r')
+///        at the beginning of `str`
+/// @param str : the target string
+/// @param length : the length of the target string
+size_t span_whitespace(const char * const str, size_t length);
+
+/// @brief the length of the run of `[A-Za-z0-9_]` at the beginning of `str`
+size_t span_word(const char * const str, size_t length);
+
+/// @brief the length of the run of `[0-9]` at the beginning of `str`
+size_t span_digits(const char * const str, size_t length);
+
+/// @brief the instruction set the spans are running on: "avx2", "sse2" or "scalar",
+///        picked once at startup from what the cpu supports
+const char * char_scan_isa();
+
+}
+
+#endif
@@ -12,8 +12,9 @@ namespace DRCC
 class mipsCodeGen
 {
 private:
-    /// @brief symbol table: name -> offset
-    std::map<std::string, int> symbol_table;
+    /// @brief symbol table: identifier id -> offset, 0 if the identifier is not declared
+    ///        (the offsets of variables start at 4)
+    std::vector<int> symbol_table;
 
     /// @brief the pointer to the root node of Abstract Syntax Tree (AST)
     std::shared_ptr<ASTNode> root;
@@ -0,0 +1,37 @@
+#ifndef DRCC_IDENTIFIERS_H
+#define DRCC_IDENTIFIERS_H
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace DRCC
+{
+
+/// @brief interned identifiers: each distinct name gets a dense id, in order of first use
+/// @attention the names are not copied, they must outlive the table (the scanner interns
+///            lexemes, which live in `Scanner::source`)
+class IdentifierTable
+{
+private:
+    std::unordered_map<std::string_view, int> ids;
+    std::vector<std::string_view> names;
+
+public:
+
+    /// @brief the id of a token that is not an identifier
+    static constexpr int NO_ID = -1;
+
+    /// @brief the id of `name`, a new one if it is not seen before
+    int intern(std::string_view name);
+
+    /// @brief the name of an interned id
+    std::string_view name(int id) const;
+
+    /// @brief the number of ids, they are `0 .. size() - 1`
+    int size() const;
+};
+
+}
+
+#endif
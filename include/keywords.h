@@ -0,0 +1,85 @@
+#ifndef DRCC_KEYWORDS_H
+#define DRCC_KEYWORDS_H
+
+#include "tokenType.h"
+
+#include <array>
+#include <string_view>
+
+namespace DRCC
+{
+
+/// @brief a reserved word and its token
+struct Keyword
+{
+    std::string_view word;
+    TokenType token_type;
+};
+
+/// @brief all the keywords of the language
+constexpr Keyword KEYWORDS[] = {
+    { "int", INT },
+    { "main", MAIN },
+    { "void", VOID },
+    { "break", BREAK },
+    { "do", DO },
+    { "else", ELSE },
+    { "if", IF },
+    { "while", WHILE },
+    { "return", RETURN },
+    { "scanf", READ },
+    { "printf", WRITE },
+};
+
+/// @brief the slots of the keyword hash table, a power of 2
+constexpr size_t KEYWORD_SLOTS = 16;
+
+/// @brief the hash of a non-empty word: its first byte and its length, which tell the
+///        keywords apart (checked below, change the multiplier if a new keyword collides)
+constexpr size_t keyword_hash(std::string_view word)
+{
+    return (static_cast<unsigned char>(word[0]) + 8 * word.size()) & (KEYWORD_SLOTS - 1);
+}
+
+/// @brief the perfect hash table of the keywords, the empty slots hold an empty word
+constexpr std::array<Keyword, KEYWORD_SLOTS> make_keyword_table()
+{
+    std::array<Keyword, KEYWORD_SLOTS> table = {};
+    for(const Keyword & keyword : KEYWORDS)
+    {
+        table[keyword_hash(keyword.word)] = keyword;
+    }
+    return table;
+}
+
+constexpr std::array<Keyword, KEYWORD_SLOTS> KEYWORD_TABLE = make_keyword_table();
+
+constexpr bool keyword_hash_is_perfect()
+{
+    for(const Keyword & keyword : KEYWORDS)
+    {
+        if(KEYWORD_TABLE[keyword_hash(keyword.word)].word != keyword.word)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(keyword_hash_is_perfect(), "two keywords share a slot of the keyword hash table");
+
+/// @brief the token of an identifier-like word: its keyword, `ID` if it is not one
+constexpr TokenType keyword_type(std::string_view word)
+{
+    if(word.empty())
+    {
+        return ID;
+    }
+
+    const Keyword & slot = KEYWORD_TABLE[keyword_hash(word)];
+    return slot.word == word ? slot.token_type : ID;
+}
+
+}
+
+#endif
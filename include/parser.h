@@ -4,12 +4,16 @@
 #include "tokenType.h"
 #include "scanner.h"
 #include "symbols.h"
+#include "identifiers.h"
 
 #include <vector>
+#include <bitset>
 #include <map>
 #include <set>
 #include <memory>
 #include <unordered_map>
+#include <ostream>
+#include <cstdint>
 
 namespace DRCC
 {
@@ -39,6 +43,70 @@ struct ActionEntry
 };
 
 
+/// @brief the number of terminal (non-terminal) symbols
+constexpr int NUM_TERMINALS = END + 1;
+constexpr int NUM_NONTERMINALS = NONTERMINAL_COUNT;
+
+/// @brief an action table entry packed in 32 bits: the target above the 2 bits of the action
+typedef uint32_t PackedAction;
+
+constexpr PackedAction pack_action(ActionEntryEnum action, int target)
+{
+    return static_cast<uint32_t>(target) << 2 | static_cast<uint32_t>(action);
+}
+
+constexpr ActionEntryEnum action_of(PackedAction entry)
+{
+    return static_cast<ActionEntryEnum>(entry & 3);
+}
+
+constexpr int target_of(PackedAction entry)
+{
+    return entry >> 2;
+}
+
+/// @brief the finished LR(1) parsing tables, all that `Parser::parse` runs on
+/// @note both tables are row-displacement (comb) compressed: the rows are overlaid in one
+///       vector, each at the offset `base` of the row, and `check` tells which row owns a slot.
+///       The entries a row does not own are its default: the most frequent reduction of an
+///       ACTION row (error if none), the most frequent target of a GOTO column
+struct ParseTables
+{
+    int num_states;
+    int initial_state;
+
+    /// @brief ACTION[state][terminal]: `action[action_base[state] + terminal]` if
+    ///        `action_check` there is `state`, `default_action[state]` otherwise
+    const int * action_base;
+    const int * action_check;
+    const PackedAction * action;
+    const PackedAction * default_action;
+
+    /// @brief GOTO[state][nonterminal], by columns: `goto_state[goto_base[nonterminal] + state]`
+    ///        if `goto_check` there is `nonterminal`, `default_goto[nonterminal]` otherwise
+    const int * goto_base;
+    const int * goto_check;
+    const int * goto_state;
+    const int * default_goto;
+
+    /// @brief the length of the right-hand side of each production
+    const int * rhs_length;
+
+    /// @brief the left-hand side of each production
+    const NonTerminal * lhs;
+};
+
+/// @brief how the parsing tables are constructed
+enum class TableConstruction
+{
+    /// @brief canonical LR(1): item sets with their lookaheads
+    CANONICAL_LR1,
+
+    /// @brief LALR(1): LR(0) item sets, lookaheads by the DeRemer-Pennello relations, and
+    ///        canonical LR(1) if merging the states causes conflicts
+    LALR1,
+};
+
 /// @brief Abstract Syntax Tree Node
 class ASTNode
 {
@@ -53,7 +121,19 @@ public:
 
     /// @brief the lexem the current token is carrying
     /// @attention applicable only if the current symbo is a teminal symbol (token)
-    std::string lexeme;
+    std::string_view lexeme;
+
+    /// @brief the interned id of an identifier
+    /// @attention applicable only if the current symbol is `ID`
+    int symbol_id;
+
+    /// @brief the storage the lexemes of the tree point into
+    /// @attention set on the root only, by `Parser::parse`
+    std::shared_ptr<const void> source;
+
+    /// @brief the identifiers of the tree, indexed by `symbol_id`
+    /// @attention set on the root only, by `Parser::parse`
+    std::shared_ptr<const IdentifierTable> identifiers;
 
     /// @brief the child nodes that fits the right-hand-side of the current production rule
     /// @attention applicable only if the current symbol is a non-terminal symbol
@@ -62,7 +142,7 @@ public:
 public:
     ASTNode(Token tok);
     ASTNode(NonTerminal symb, int prod_idx, 
-        const std::vector<std::shared_ptr<ASTNode>> children);
+        std::vector<std::shared_ptr<ASTNode>> children);
 };
 
 // LR(1) item
@@ -74,13 +154,54 @@ public:
     Terminal lookahead;
 
     LR1Item(int prod_idx, int position, Terminal lookahead);
-    bool operator<(const LR1Item & rhs) const;
+
+    /// @brief the item of a packed key
+    explicit LR1Item(uint64_t key);
+
+    /// @brief the item packed in 64 bits: the production, the position and the lookahead from
+    ///        the high bits down
+    uint64_t key() const;
+};
+
+/// @brief a set of LR(1) items, as the sorted keys of the items and their hash
+class LR1ItemSet
+{
+public:
+    std::vector<uint64_t> keys;
+    size_t hash = 0;
+
+    /// @brief add an item, the set is `seal`ed once all are added
+    void add(const LR1Item & item);
+
+    /// @brief sort the keys, drop the duplicates and compute the hash
+    void seal();
+
+    size_t size() const;
+    bool operator==(const LR1ItemSet & rhs) const;
+};
+
+struct LR1ItemSetHash
+{
+    size_t operator()(const LR1ItemSet & I) const
+    {
+        return I.hash;
+    }
 };
 
 typedef std::vector<Production> Grammar;
-typedef std::set<LR1Item> LR1ItemSet;
-typedef std::map<LR1ItemSet, int> LR1ItemSetId;
+typedef std::unordered_map<LR1ItemSet, int, LR1ItemSetHash> LR1ItemSetId;
 typedef std::map<int, std::map<Symbol, int>> GotoTable;
+typedef std::bitset<NUM_TERMINALS> TerminalSet;
+
+/// @brief an item [C -> . d] of the closure of a non-terminal B, that is of the items
+///        [A -> a . B b, x]: the lookaheads generated spontaneously within the closure, and
+///        whether FIRST(b x) propagates to it
+struct ClosureItem
+{
+    int prod_idx;
+    TerminalSet spontaneous;
+    bool propagated;
+};
 
 class Parser
 {
@@ -88,6 +209,9 @@ private:
     /// @brief initial state in the parsing process
     int initial_state;
 
+    /// @brief how `init` constructs the tables
+    TableConstruction construction;
+
     /// @brief the scanner
     std::unique_ptr<Scanner> scanner;
 
@@ -101,14 +225,18 @@ private:
     std::set<Symbol> _terminals;
     std::set<Symbol> _nonterminals;
 
-    /// @brief map from idx to I_{idx}
+    /// @brief map from idx to the kernel of I_{idx}: the start item and the items past their
+    ///        first symbol, the rest is computed on demand by `make_closure`
+    /// @note the LALR(1) collection holds the reduce items of I_{idx} instead
     std::vector<LR1ItemSet> _lr1_items;
     
-    /// @brief map I to its index
+    /// @brief map the kernel of I to its index
     LR1ItemSetId _lr1_item_idx;
 
+    /// @brief the closure items of each non-terminal, filled by `_nonterminal_closure`
+    std::map<Symbol, std::vector<ClosureItem>> _closure_cache;
     
-    /// @brief memorize goto_function
+    /// @brief the GOTO function
     GotoTable _goto_archive;
 
     /// @brief ACTION table in parsing
@@ -117,36 +245,79 @@ private:
     /// @brief GOTO table in parsing
     std::unordered_map<int, std::map<NonTerminal, int>> _goto_transition_tab;
 
+    /// @brief the tables `parse` runs on: the generated ones, or those built by `init`
+    ParseTables tables;
+
+    /// @brief the storage of `tables` if they are built at runtime
+    std::vector<int> _action_base;
+    std::vector<int> _action_check;
+    std::vector<PackedAction> _action;
+    std::vector<PackedAction> _default_action;
+    std::vector<int> _goto_base;
+    std::vector<int> _goto_check;
+    std::vector<int> _goto_state;
+    std::vector<int> _default_goto;
+    std::vector<int> _rhs_length;
+    std::vector<NonTerminal> _lhs;
+
 
 
-    /// @brief GOTO table function
-    /// @param itemset_idx 
-    /// @param X 
-    /// @return GOTO(Ii, X)
-    int _goto(int itemset_idx, Symbol X);
+    /// @brief the items of the closure of a non-terminal, cached
+    const std::vector<ClosureItem> & _nonterminal_closure(Symbol B);
 
-    /// @brief Compute (in-place) the LR1 closure of the grammar itemset
-    /// @param I initial itemset
-    LR1ItemSet make_closure(LR1ItemSet & I);
+    /// @brief the FIRST set of `rhs[from..]` followed by nothing
+    /// @return whether `rhs[from..]` is nullable
+    bool _first_of(const std::vector<Symbol> & rhs, size_t from, TerminalSet & first);
+
+    /// @brief Compute the LR1 closure of a kernel, less the kernel
+    /// @param kernel the kernel items
+    /// @return the productions of the closure items and their lookaheads
+    std::map<int, TerminalSet> make_closure(const LR1ItemSet & kernel);
 
     /// @brief Construct the collection of sets of LR(1) items for the augmented grammar
     void _construct_cannonical_lr1_items();
 
+    /// @brief Construct the LALR(1) collection: the LR(0) item sets, with the reduce items
+    ///        of each set carrying their LALR(1) lookaheads, in place of the canonical one
+    /// @return `false` (and nothing is constructed) if merging the states of the canonical
+    ///         collection causes reduce/reduce conflicts
+    bool _construct_lalr1_items();
+
     /// @brief Compute the first sets of every symbol
     void _compute_first_set();
 
     /// @brief Construction of canonical-LR parsing tables
     void _construct_lr1_parsing_table();
 
+    /// @brief Pack the ACTION and GOTO tables into the compressed `tables`
+    void _pack_parsing_table();
+
 
 public:
-    Parser(std::unique_ptr<Scanner> scanner);
-    std::shared_ptr<ASTNode> parse();
+    Parser(std::unique_ptr<Scanner> scanner,
+        TableConstruction construction = TableConstruction::LALR1);
+
+    /// @brief parse the tokens of the scanner
+    /// @param pipelined : run the scanner on its own thread, which hands the tokens over in
+    ///        batches, so that scanning and parsing overlap
+    /// @return the root of the AST, `nullptr` on a syntax error
+    std::shared_ptr<ASTNode> parse(bool pipelined = false);
     void init();
 
     void print_table();
+
+    /// @brief write a C++ source defining `DRCC::generated_parse_tables`, the tables of the
+    ///        grammar as constexpr arrays, built with `-DDRCC_GENERATED_TABLES` the parser
+    ///        runs on them and never constructs its tables
+    /// @attention a parser built with `-DDRCC_GENERATED_TABLES` has no grammar to write
+    void generate_tables(std::ostream & os) const;
 };
 
+#ifdef DRCC_GENERATED_TABLES
+/// @brief generated by `Parser::generate_tables`, see the `parse-tables` make target
+extern const ParseTables generated_parse_tables;
+#endif
+
 /// @brief Helper funtion, generate the C grammar
 /// @return c grammar list
 Grammar c_grammar();
@@ -2,8 +2,12 @@
 #define DR_FINITE_STATE_MACHINE_H
 
 #include <set>
+#include <string>
 #include <map>
 #include <vector>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -25,6 +29,25 @@ public:
 
     NFA(int num_states, int start_state = 0);
 
+    NFA(const NFA & src) = default;
+
+    /// @brief take over the states of `src`, which is left empty
+    NFA(NFA && src) = default;
+
+    /// @brief append a new state without transitions
+    /// @return the index of the new state
+    int add_state();
+
+    /// @brief reserve room for `num_states` states in total
+    void reserve(int num_states);
+
+    /// @brief copy the states and transitions of `src` to the end of the nfa (accept states
+    ///        are not copied)
+    /// @param keep_closures : copy the lambda closures too if `src` is built, only valid if
+    ///        no lambda move leaving the copied states is added afterwards
+    /// @return the index of the first copied state
+    int append(const NFA & src, bool keep_closures = false);
+
     /// @brief add transition: (from)--[ch]-->(to) 
     ///         after the operation, state (from) can transfer to (to) by 1 additional (ch) 
     void add_transition(int from, char ch, int to);
@@ -32,16 +55,18 @@ public:
     /// @brief states in dsts can be reached from (from) by a new (ch)
     void add_transitions(int from, char ch, const StateSet &dsts);
     
-    // add an accept state to the nfa
-    void add_accept_state(int state);
+    /// @brief add an accept state to the nfa
+    /// @param tag : the label of the accept state, the smallest tag wins when a dfa
+    ///              state contains several tagged accept states
+    void add_accept_state(int state, int tag = 0);
 
     // remove a state from the accept state set of the nfa
     void remove_accept_state(int state);
 
     /// @brief the set of states that can be reached from the state `state` via '\0'
     /// @param state 
-    /// @return the lambda closure
-    const StateSet & lambda_closure(int state) const;
+    /// @param closure : set to the lambda closure in ascending order, empty if not built
+    void lambda_closure(int state, std::vector<int> & closure) const;
 
     /// @brief the neiboring states of a given state
     /// @param state 
@@ -54,6 +79,13 @@ public:
     /// @brief return the archived accept state set 
     const StateSet & accept_states() const;
 
+    /// @brief the tag of an accept state, `NO_TAG` if the state is accepted only
+    ///        through the lambda closure (or not accepted at all)
+    int accept_tag(int state) const;
+
+    /// @brief the tag of states without an explicit tag
+    static constexpr int NO_TAG = -1;
+
 
     /// @brief the start state of the nfa, i.e., where to start matching 
     int start_state() const;
@@ -71,16 +103,44 @@ public:
     /// @brief the number of states in the nfa  
     int size() const;
 
+    /// @brief partition the bytes into classes that no transition tells apart
+    /// @param byte_class : resized to 256, `byte_class[(unsigned char) ch]` is the class of ch
+    /// @return the number of classes
+    int byte_classes(std::vector<uint8_t> & byte_class) const;
+
     /// @brief deep copy assignment of nfa 
     NFA & operator= (const NFA & src);
 
+    /// @brief move assignment of nfa
+    NFA & operator= (NFA && src) = default;
+
     /// @brief reduce the nfa and delete all the computed lambda closures
     void degrade();
 
 private:
 
-    /// @brief compute the lambda closure of a given state  
-    void compute_lambda_closure(int state);
+    /// @brief the component of a state whose closure is not computed
+    static constexpr int NO_COMPONENT = -1;
+
+    /// @brief the closures of at most this many states are stored whole, larger ones are
+    ///        linked to the components they reach, so that a long lambda chain stays linear
+    static constexpr size_t MAX_EXPANDED_CLOSURE = 64;
+
+    /// @brief a lambda-strongly-connected component, all its members share its closure
+    struct LambdaComponent
+    {
+        /// @brief the sorted closure if `links` is empty, otherwise the members only
+        std::vector<int> states;
+
+        /// @brief the components moved to, their closures are the rest of the closure
+        std::vector<int> links;
+
+        /// @brief an upper bound of the size of the closure
+        size_t size_bound;
+
+        /// @brief whether the closure contains an accept state
+        bool accepting;
+    };
 
 private:
 
@@ -96,11 +156,18 @@ private:
     /// @brief the set of accept states
     StateSet accept_states_;
 
+    /// @brief the tags of the explicitly added accept states
+    std::map<int, int> accept_tags_;
+
     /// @brief transition map
     std::vector<std::unordered_map<char, StateSet>> transitions_;
 
-    /// @brief lambda closure of each state
-    std::vector<StateSet> lambda_closure_;
+    /// @brief `component_[state]` is the index of the component of the state in
+    ///        `components_`, or `NO_COMPONENT`
+    std::vector<int> component_;
+
+    /// @brief the lambda-strongly-connected components, in reverse topological order
+    std::vector<LambdaComponent> components_;
 };
 
 
@@ -112,7 +179,14 @@ public:
 
     /// @brief construct the dfa from a nfa
     /// @param nfa 
-    DFA(const NFA & nfa);
+    /// @param minimize : run Hopcroft minimization as part of `build`
+    DFA(const NFA & nfa, bool minimize = true);
+
+    /// @brief deep copy, a loaded dfa shares the buffer with its source
+    DFA(const DFA & src);
+
+    /// @brief take over the tables of `src`
+    DFA(DFA && src);
 
 
     /// @brief match a target string an find out the largest prefix matched
@@ -121,22 +195,97 @@ public:
     /// @return the maximum matched length
     int max_accept_length(const char * const str, int max_length) const;
 
+    /// @brief match a target string an find out the largest prefix matched, together with
+    ///        the tag of the accept state reached at the end of that prefix
+    /// @param str 
+    /// @param max_length the length of the buffer
+    /// @param tag the tag of the match, unchanged if nothing is matched
+    /// @return the maximum matched length
+    int max_accept_length(const char * const str, int max_length, int & tag) const;
+
+    /// @brief match with a tag, and tell if the input ran out before the dfa stopped
+    /// @param truncated : `true` if the dfa is still alive at the end of the buffer, i.e., a
+    ///        longer match may follow if more input is appended
+    int max_accept_length(const char * const str, int max_length, int & tag, bool & truncated) const;
 
-    /// @brief build the dfa from the compiled nfa
+
+    /// @brief build the dfa from the compiled nfa (and minimize it if enabled)
     void build();
 
+    /// @brief enable or disable the minimization pass of `build`
+    void set_minimize(bool minimize);
+
+    /// @brief the number of states of the built dfa
+    int size() const;
+
+    /// @brief the number of states produced by subset construction, before minimization
+    int unminimized_size() const;
+
+    /// @brief the number of byte equivalence classes (columns of the compiled table)
+    int num_byte_classes() const;
+
+    /// @brief the start state of the compiled table
+    int32_t start_state() const;
 
-    /// @brief deep copy assignment 
+    /// @brief the class of a byte, i.e., its column in the compiled table
+    int byte_class(unsigned char ch) const;
+
+    /// @brief the state reached from `state` by a byte of class `c`, `DEAD_STATE` if none
+    int32_t next_state(int32_t state, int c) const;
+
+    /// @brief `true` if `state` is an accept state of the compiled table
+    bool is_accept_state(int32_t state) const;
+
+    /// @brief the tag of an accept state of the compiled table
+    int32_t accept_tag(int32_t state) const;
+
+
+    /// @brief write the compiled tables in the binary format read by `load`
+    /// @param os : a binary stream
+    /// @param checksum : identifies what the dfa is built from, checked by `load`
+    void save(std::ostream & os, uint64_t checksum) const;
+
+    /// @brief use the compiled tables of a buffer written by `save` in place, without copying
+    /// @param data : the buffer, it must outlive the dfa (e.g., a memory mapped file)
+    /// @param size : the size of the buffer in bytes
+    /// @param checksum : the expected checksum
+    /// @param num_tags : accept tags must lie in [0, num_tags)
+    /// @return `false` (and the dfa is unchanged) if the buffer is malformed, of another
+    ///         version, or built from something else
+    bool load(const void * data, size_t size, uint64_t checksum, int num_tags);
+
+    /// @brief deep copy assignment, a loaded dfa shares the buffer with its source
     DFA & operator= (const DFA & src);
 
+    /// @brief move assignment, takes over the tables of `src`
+    DFA & operator= (DFA && src);
+
     /// @brief `true` if the nfa is finshed generating `lambda_closure` 
     bool nfa_built() const;
 
+    /// @brief the number of distinct input bytes
+    static constexpr int ALPHABET_SIZE = 256;
+
+    /// @brief the version of the binary format of `save` and `load`
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    /// @brief the sentinel in the compiled table marking a missing transition
+    static constexpr int32_t DEAD_STATE = -1;
+
 private:
 
     /// @brief build the dfa from a compiled nfa
     void build_from_nfa_();
 
+    /// @brief merge equivalent states by Hopcroft partition refinement
+    void minimize_();
+
+    /// @brief flatten `transitions_`, `accept_states_` and `accept_tags_` into the compiled tables
+    void compile_table_();
+
+    /// @brief let the table pointers refer to the owned compiled tables
+    void use_owned_tables_();
+
 private:
     
     /// @brief if the dfa is based on nfa (true in this project)
@@ -145,19 +294,282 @@ private:
     /// @brief the pointer to the base nfa
     const NFA * nfa_p;
 
+    /// @brief `true` if `build` runs the minimization pass
+    bool minimize_enabled_;
+
     /// @brief the size of the dfa, determined on `build`
     int num_states_;
 
+    /// @brief the size of the dfa before minimization
+    int num_raw_states_;
+
     /// @brief the start state of the dfa
     int start_state_;
 
     /// @brief accept states of the dfa
     StateSet accept_states_;
 
-    /// @brief the transition map
-    std::map<int, std::unordered_map<char, int>> transitions_;
+    /// @brief the tag of each accept state (the smallest tag of the nfa accept states it contains)
+    std::map<int, int> accept_tags_;
 
-    
+    /// @brief the number of byte equivalence classes
+    int num_classes_;
+
+    /// @brief `byte_class_[(unsigned char) ch]` is the equivalence class of ch
+    std::vector<uint8_t> byte_class_;
+
+    /// @brief the transition map on byte classes (used during construction)
+    std::map<int, std::unordered_map<int, int>> transitions_;
+
+    /// @brief the compiled transition table in row-major order, `table_[state * num_classes_ 
+    ///        + byte_class_[(unsigned char) ch]]` is the next state or `DEAD_STATE`
+    std::vector<int32_t> table_;
+
+    /// @brief the compiled accept states, `accept_map_[state]` is 1 if `state` is accepted
+    std::vector<uint8_t> accept_map_;
+
+    /// @brief the compiled accept tags, `accept_tag_map_[state]` is the tag of an accepted `state`
+    std::vector<int32_t> accept_tag_map_;
+
+    /// @brief the tables used for matching, either the owned ones above or a loaded buffer
+    const uint8_t * byte_class_p;
+    const int32_t * table_p;
+    const uint8_t * accept_map_p;
+    const int32_t * accept_tag_map_p;
+
+    /// @brief `true` if the table pointers refer to a loaded buffer
+    bool loaded_;
+};
+
+
+
+/// @brief Determined Finite Automation built on demand: a dfa state is created from the
+///        lambda closures of the nfa only when the input reaches it, and kept in a cache
+///        bounded by a memory budget. The cache is flushed when it is full, if it keeps
+///        filling up during one match the rest of the match is simulated on the nfa.
+/// @attention the nfa must outlive the lazy dfa and stay unchanged while it is used
+/// @attention not thread-safe: the matching methods are `const` but update the cache
+class LazyDFA
+{
+public:
+
+    /// @brief construct the lazy dfa from a nfa
+    /// @param nfa 
+    /// @param cache_budget : the bytes the cached states may take
+    LazyDFA(const NFA & nfa, size_t cache_budget = DEFAULT_CACHE_BUDGET);
+
+    /// @brief match a target string an find out the largest prefix matched
+    /// @param str 
+    /// @param max_length the length of the buffer
+    /// @return the maximum matched length
+    int max_accept_length(const char * const str, int max_length) const;
+
+    /// @brief match a target string an find out the largest prefix matched, together with
+    ///        the tag of the accept state reached at the end of that prefix
+    /// @param tag the tag of the match, unchanged if nothing is matched
+    int max_accept_length(const char * const str, int max_length, int & tag) const;
+
+    /// @brief prepare the byte classes and the start state, the nfa must be built
+    void build();
+
+    /// @brief change the memory budget of the cache (flushes the cache)
+    void set_cache_budget(size_t cache_budget);
+
+    /// @brief the memory budget of the cache in bytes
+    size_t cache_budget() const;
+
+    /// @brief the number of states currently cached
+    int size() const;
+
+    /// @brief the number of times the cache has been flushed
+    int num_flushes() const;
+
+    /// @brief the default budget of the state cache in bytes
+    static constexpr size_t DEFAULT_CACHE_BUDGET = 1 << 20;
+
+    /// @brief a flush-heavy match falls back to nfa simulation after this many flushes
+    static constexpr int MAX_FLUSHES_PER_MATCH = 4;
+
+private:
+
+    /// @brief the closure reached from `closure` by one byte of class `c`, sorted
+    void step_(const std::vector<int> & closure, int c, std::vector<int> & next) const;
+
+    /// @brief the id of a cached closure, caching it if it is new
+    /// @return the id, or `DEAD_STATE` if the cache has no room left
+    int32_t intern_(const std::vector<int> & closure) const;
+
+    /// @brief drop all cached states but the start state
+    void flush_() const;
+
+    /// @brief keep matching on the nfa from `closure`, after `pos` bytes have been consumed
+    int simulate_nfa_(std::vector<int> closure, const char * const str, int pos, int max_length,
+        int max_ans, int & tag) const;
+
+    /// @brief the smallest tag of the accept states in a closure, `NFA::NO_TAG` if none is tagged
+    int closure_tag_(const std::vector<int> & closure) const;
+
+    /// @brief hash of a sorted closure
+    struct ClosureHash
+    {
+        size_t operator()(const std::vector<int> & closure) const;
+    };
+
+private:
+
+    /// @brief the pointer to the base nfa
+    const NFA * nfa_p;
+
+    /// @brief the budget of the cache in bytes
+    size_t cache_budget_;
+
+    /// @brief the number of byte equivalence classes
+    int num_classes_;
+
+    /// @brief `byte_class_[(unsigned char) ch]` is the equivalence class of ch
+    std::vector<uint8_t> byte_class_;
+
+    /// @brief `class_repr_[c]` is the smallest byte of class c
+    std::vector<unsigned char> class_repr_;
+
+    /// @brief the cache, the members below grow as the input is matched
+    mutable int32_t start_state_;
+    mutable size_t cache_bytes_;
+    mutable int num_flushes_;
+
+    /// @brief the nfa closure of each cached state
+    mutable std::vector<std::vector<int>> closures_;
+
+    /// @brief closure -> cached state
+    mutable std::unordered_map<std::vector<int>, int32_t, ClosureHash> closure_idx_;
+
+    /// @brief `table_[state * num_classes_ + c]` is the next state, `DEAD_STATE`, or
+    ///        `UNKNOWN_STATE` if not explored yet
+    mutable std::vector<int32_t> table_;
+
+    /// @brief 1 if the cached state is accepted
+    mutable std::vector<uint8_t> accept_map_;
+
+    /// @brief the tag of each cached accept state
+    mutable std::vector<int32_t> accept_tag_map_;
+
+    /// @brief scratch space of `step_`, one flag per nfa state
+    mutable std::vector<uint8_t> mark_;
+
+    /// @brief scratch space of `step_`, the closure of a state moved to
+    mutable std::vector<int> to_closure_;
+
+    /// @brief the sentinel of a transition that is not computed yet
+    static constexpr int32_t UNKNOWN_STATE = -2;
+};
+
+
+/// @brief Bit-parallel simulation of the Glushkov automaton of a small nfa: each position
+///        (a state entered by a fixed set of bytes) is one bit of a word, and one byte of
+///        input costs a few table lookups and word operations. Nothing like subset
+///        construction is done, so building is linear in the size of the nfa.
+///        The tables are self-contained, the nfa is not needed after `build`.
+class BitParallelNFA
+{
+public:
+
+    BitParallelNFA();
+
+    /// @brief build the tables from a built nfa
+    /// @return `false` (and the matcher is left empty) if the nfa has more than
+    ///         `MAX_POSITIONS` positions
+    bool build(const NFA & nfa);
+
+    /// @brief match a target string an find out the largest prefix matched
+    /// @param str 
+    /// @param max_length the length of the buffer
+    /// @return the maximum matched length
+    int max_accept_length(const char * const str, int max_length) const;
+
+    /// @brief match a target string an find out the largest prefix matched, together with
+    ///        the tag of the accept position reached at the end of that prefix
+    /// @param tag the tag of the match, unchanged if nothing is matched
+    int max_accept_length(const char * const str, int max_length, int & tag) const;
+
+    /// @brief the number of positions, including the initial one
+    int size() const;
+
+    /// @brief the positions fit in one machine word
+    static constexpr int MAX_POSITIONS = 64;
+
+private:
+
+    /// @brief the positions that may follow one of the positions in `set`
+    uint64_t follow_(uint64_t set) const;
+
+private:
+
+    /// @brief the number of positions, position 0 is the start state
+    int num_positions_;
+
+    /// @brief the number of 8-position chunks of `follow_table_`
+    int num_chunks_;
+
+    /// @brief `follow_table_[k * 256 + b]` is the union of the follow sets of the positions
+    ///        `8k + j` for the bits j set in b
+    std::vector<uint64_t> follow_table_;
+
+    /// @brief `byte_mask_[(unsigned char) ch]` are the positions entered by ch
+    std::vector<uint64_t> byte_mask_;
+
+    /// @brief the accept positions
+    uint64_t accept_mask_;
+
+    /// @brief the tag of each position, `NFA::NO_TAG` if not accepted or not tagged
+    std::vector<int> tags_;
+};
+
+
+/// @brief Finds where a match of a nfa may start, so that an unanchored search only runs the
+///        anchored matcher there. Built from the literal prefix every non-empty match starts
+///        with (searched by its rarest byte with `memchr`), or else from the set of bytes a
+///        match may start with.
+class Prefilter
+{
+public:
+
+    Prefilter();
+
+    /// @brief extract the literal prefix and the first bytes from a built nfa
+    void build(const NFA & nfa);
+
+    /// @brief the first position in [from, length) where a match may start
+    /// @param str : the target string
+    /// @param from : where to start looking
+    /// @param length : the length of the target string
+    /// @return `length` if no match can start in the rest of the string
+    size_t next_candidate(const char * const str, size_t from, size_t length) const;
+
+    /// @brief `true` if the nfa matches the empty string, every position is then a candidate
+    bool matches_empty() const;
+
+    /// @brief the literal every non-empty match starts with (possibly empty)
+    const std::string & literal_prefix() const;
+
+    /// @brief the longest literal prefix extracted
+    static constexpr size_t MAX_PREFIX = 64;
+
+private:
+
+    /// @brief the prefix every match starts with
+    std::string prefix_;
+
+    /// @brief the index of the rarest byte of `prefix_`, the one looked for with `memchr`
+    size_t rare_index_;
+
+    /// @brief `first_bytes_[(unsigned char) ch]` is 1 if a match may start with ch
+    std::vector<uint8_t> first_bytes_;
+
+    /// @brief the bytes of `first_bytes_`, if there are few of them
+    std::string first_byte_list_;
+
+    /// @brief `true` if the empty string is matched
+    bool matches_empty_;
 };
 
 
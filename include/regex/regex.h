@@ -4,10 +4,15 @@
 #include "regex/fsm.h"
 
 #include <set>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace Regex 
 {
 
+class RegexSet;
+
 /// @brief the Regular Expression Pattern Object, use underlying FSMs to indicate the pattern 
 class RegexPatObj
 {
@@ -17,6 +22,9 @@ public:
     /// @param nfa : the Non-determined Finite Automata
     RegexPatObj(const FSM::NFA & nfa);
 
+    /// @brief regex from a nfa, taking over its states (e.g., the result of `NFABuilder::build`)
+    RegexPatObj(FSM::NFA && nfa);
+
     /// @brief regex from a fixed patterns (without parameters and operations)
     /// @param pattern : the finite fixed pattern 
     RegexPatObj(const char * const pattern);
@@ -32,23 +40,55 @@ public:
     /// @param range_last : the last character in the range
     RegexPatObj(char range_first, char range_last);
 
+    /// @brief copy a regex, a lazily compiled copy gets a lazy dfa of its own
+    RegexPatObj(const RegexPatObj & src);
+
+    /// @brief move a regex, `src` is left empty
+    RegexPatObj(RegexPatObj && src);
+
     /// @brief find the longest prefix of a string that matches the regex
     /// @param str : the target string
     /// @param length : the length of the target string
     /// @return the length of the larges prefix of `str` that matches
+    /// @attention not thread-safe if compiled by `compile_lazy`
     int max_matched_lenghth(const char * const str, int length) const;
 
+    /// @brief find the leftmost match in a string, and the longest one starting there
+    /// @param str : the target string
+    /// @param length : the length of the target string
+    /// @param match_begin : where the match starts
+    /// @param match_length : the length of the match
+    /// @param from : where to start searching
+    /// @return `false` if there is no match in [from, length), or the regex is not compiled
+    /// @attention not thread-safe if compiled by `compile_lazy`
+    bool find(const char * const str, int length, int & match_begin, int & match_length, int from = 0) const;
+
+    /// @brief all the non-overlapping matches in a string, searched from left to right
+    /// @param str : the target string
+    /// @param length : the length of the target string
+    /// @return the (begin, length) of each match, none if the regex is not compiled
+    /// @attention not thread-safe if compiled by `compile_lazy`
+    std::vector<std::pair<int, int>> find_all(const char * const str, int length) const;
+
     /// @brief generate C = AB
     /// @param rhs : the right-hand-side reg
     /// @return the concatenated regex
     RegexPatObj operator+ (const RegexPatObj & rhs) const;
 
+    /// @brief A = AB in place, only the states of `rhs` are copied
+    /// @param rhs : the right-hand-side reg
+    /// @return *this to support chaining operation
+    RegexPatObj & operator+= (const RegexPatObj & rhs);
+
+    /// @brief generate C = AB from a temporary A, which is extended in place
+    RegexPatObj friend operator+ (RegexPatObj && lhs, const RegexPatObj & rhs);
+
     /// @brief generate C = A | B
     /// @param rhs : the right-hand-side reg
     /// @return the unioned regex
     RegexPatObj operator| (const RegexPatObj & rhs) const;
 
-    /// @brief generate C = A{m}
+    /// @brief generate C = A{m}, in time linear to the size of C
     /// @param times : the times of repetition
     /// @return the repeated regex
     RegexPatObj operator* (int times) const;
@@ -58,22 +98,244 @@ public:
     /// @return *this to support chaining operation
     RegexPatObj & operator= (const RegexPatObj & src);
 
+    /// @brief move assigning operator, `src` is left empty
+    RegexPatObj & operator= (RegexPatObj && src);
+
     /// @brief generate C = A{m}A* 'friend'
     RegexPatObj friend RegexIter(const RegexPatObj & regex, int min_times);
 
-    /// @brief compile the nfa into dfa
-    void compile();
+    /// @brief the set merges the nfa of its patterns
+    friend class RegexSet;
+
+    /// @brief compile the nfa for matching: patterns of at most `BitParallelNFA::MAX_POSITIONS`
+    ///        positions are simulated bit-parallel without building a dfa, larger ones are
+    ///        compiled into dfa
+    /// @param minimize : minimize the dfa after subset construction
+    void compile(bool minimize = true);
+
+    /// @brief compile the nfa for lazy matching: dfa states are built only when the
+    ///        input reaches them, suited to patterns whose full dfa is too large
+    /// @param cache_budget : the bytes the cached dfa states may take
+    /// @attention not thread-safe: matching adds states to the cache and flushes it, unlike
+    ///        the other compiled forms which are only read. Give each thread its own copy,
+    ///        copies do not share the cache
+    void compile_lazy(size_t cache_budget = FSM::LazyDFA::DEFAULT_CACHE_BUDGET);
 
 private:
 
     /// @brief true if dfa is built
     bool compiled_;
 
+    /// @brief true if compiled by `compile_lazy`, matching uses `lazy_dfa_`
+    bool lazy_;
+
+    /// @brief true if `compile` picked the bit-parallel matcher, matching uses `bit_nfa_`
+    bool bit_parallel_;
+
     /// @brief the nfa (used to build the regex)
     FSM::NFA nfa_;
 
     /// @brief dfa : used to optimize and match targets
     FSM::DFA dfa_;
+
+    /// @brief the on-demand dfa, used instead of `dfa_` if `lazy_`
+    FSM::LazyDFA lazy_dfa_;
+
+    /// @brief the matcher of small patterns, used instead of `dfa_` if `bit_parallel_`
+    FSM::BitParallelNFA bit_nfa_;
+
+    /// @brief where a match may start, used by `find`
+    FSM::Prefilter prefilter_;
+};
+
+/// @brief Thompson construction of regexs inside one growing nfa (the arena). Fragments are
+///        combined in place by adding lambda moves, only repetitions copy states, so a regex
+///        is built in time linear to the size of its nfa. Each fragment has exactly one 
+///        start and one accept state.
+class NFABuilder
+{
+public:
+
+    /// @brief a sub-automaton of the arena
+    struct Fragment
+    {
+        /// @brief where the fragment starts matching
+        int start;
+
+        /// @brief the only accept state, with no outgoing transition until it is linked
+        int accept;
+
+        /// @brief all the states of the fragment lie in [first, last]
+        int first, last;
+    };
+
+    NFABuilder();
+
+    /// @brief matches the empty string
+    Fragment empty();
+
+    /// @brief matches a fixed string
+    Fragment literal(const std::string & str);
+
+    /// @brief matches one character in `acc_char_set`
+    Fragment char_set(const std::set<char> & acc_char_set);
+
+    /// @brief matches one character in [range_first, range_last]
+    Fragment range(char range_first, char range_last);
+
+    /// @brief AB, links `lhs` to `rhs`
+    Fragment concat(const Fragment & lhs, const Fragment & rhs);
+
+    /// @brief A | B
+    Fragment alternate(const Fragment & lhs, const Fragment & rhs);
+
+    /// @brief A*
+    Fragment star(const Fragment & frag);
+
+    /// @brief A+ (without copying A)
+    Fragment plus(const Fragment & frag);
+
+    /// @brief A?
+    Fragment optional(const Fragment & frag);
+
+    /// @brief A{min_times, max_times}, A{min_times,} if `max_times` is negative
+    /// @attention `frag` must not be linked to other fragments yet
+    Fragment repeat(const Fragment & frag, int min_times, int max_times);
+
+    /// @brief a fresh copy of a fragment
+    /// @attention `frag` must not be linked to other fragments yet
+    Fragment copy(const Fragment & frag);
+
+    /// @brief build a fragment from a textual pattern, supporting literals, `.`, `[...]` and
+    ///        `[^...]` sets with ranges, `(...)` groups, `|`, the quantifiers `*`, `+`, `?`,
+    ///        `{m}`, `{m,}`, `{m,n}`, and the escapes `\n`, `\t`, `\0`, `\d`, `\w`, `\s` 
+    ///        (any other escaped character stands for itself)
+    /// @param pattern : e.g. "[a-zA-Z][a-zA-Z0-9_]*"
+    /// @param frag : the resulting fragment
+    /// @return `false` if the pattern is malformed, see `error()`
+    bool parse(const std::string & pattern, Fragment & frag);
+
+    /// @brief the reason the last `parse` failed
+    const std::string & error() const;
+
+    /// @brief the number of states in the arena
+    int size() const;
+
+    /// @brief move the arena into a nfa accepting `frag`, the builder is left empty
+    FSM::NFA build(const Fragment & frag);
+
+private:
+
+    /// @brief a fragment made of two fresh states, `start` and `accept`
+    Fragment new_fragment_();
+
+    /// @brief recursive descent over the pattern, `pos_` is the read position
+    bool parse_alternation_(Fragment & frag);
+    bool parse_concatenation_(Fragment & frag);
+    bool parse_repetition_(Fragment & frag);
+    bool parse_atom_(Fragment & frag);
+    bool parse_set_(Fragment & frag);
+    bool parse_number_(int & value);
+
+    /// @brief record a parse error at the current position
+    bool fail_(const std::string & reason);
+
+private:
+
+    /// @brief the arena
+    FSM::NFA nfa_;
+
+    /// @brief the pattern being parsed and the read position
+    std::string pattern_;
+    size_t pos_;
+
+    /// @brief the reason the last `parse` failed
+    std::string error_;
+};
+
+/// @brief regex from a textual pattern, see `NFABuilder::parse`
+/// @param pattern : e.g. "[a-zA-Z][a-zA-Z0-9_]*"
+/// @param regex : the resulting regex, unchanged on failure
+/// @param error : if not null, the reason of a failure
+/// @return `false` if the pattern is malformed
+bool RegexParse(const std::string & pattern, RegexPatObj & regex, std::string * error = nullptr);
+
+/// @brief a prioritized set of regexs matched by a single combined automaton, the longest
+///        match wins and ties are resolved in favor of the pattern added first
+class RegexSet
+{
+public:
+
+    RegexSet();
+
+    /// @brief add a pattern to the set, patterns added earlier have higher priority
+    /// @param regex : the pattern
+    /// @param tag : the value reported when the pattern wins a match
+    void add(const RegexPatObj & regex, int tag);
+
+    /// @brief union all the patterns into one nfa and compile it into a tagged dfa
+    /// @param minimize : minimize the dfa after subset construction
+    void compile(bool minimize = true);
+
+    /// @brief compile through a cache file: if `path` holds a dfa built from the same patterns
+    ///        it is memory mapped and used in place, otherwise the set is compiled and the
+    ///        file is (re)written. Failing to read or write the file only costs the rebuild.
+    /// @attention a file not owned by the user, or writable by its group or others, is never
+    ///        loaded: keep the cache in a directory only the user can write to
+    /// @param path : the cache file, an empty path disables the cache
+    /// @param minimize : minimize the dfa after subset construction
+    /// @return `true` if the dfa is loaded from the cache
+    bool compile_cached(const std::string & path, bool minimize = true);
+
+    /// @brief find the longest prefix of a string that matches one of the patterns
+    /// @param str : the target string
+    /// @param length : the length of the target string
+    /// @param tag : the tag of the winning pattern, unchanged if nothing matches
+    /// @return the length of the larges prefix of `str` that matches
+    int max_matched_lenghth(const char * const str, int length, int & tag) const;
+
+    /// @brief the longest match, and whether the input ran out before the automaton stopped
+    /// @param truncated : `true` if a longer match may follow if more input is appended
+    int max_matched_lenghth(const char * const str, int length, int & tag, bool & truncated) const;
+
+    /// @brief the number of patterns in the set
+    int size() const;
+
+    /// @brief write the compiled dfa as a direct-coded C++ function (one label per state and
+    ///        a `switch` on the byte class, no table), with the signature and the result of
+    ///        `max_matched_lenghth`:
+    ///        `int function_name(const char * const str, int length, int & tag, bool & truncated)`
+    /// @param os : where to write the C++ source
+    /// @param function_name : the name of the function, it may be qualified
+    void emit_direct_matcher(std::ostream & os, const std::string & function_name) const;
+
+private:
+
+    /// @brief union all patterns into `nfa_`, keeping the closures of built patterns
+    void build_union_nfa_();
+
+    /// @brief a checksum of `nfa_`, the tags and the build options, identifies the cache file
+    uint64_t checksum_(bool minimize) const;
+
+private:
+
+    /// @brief true if dfa is built
+    bool compiled_;
+
+    /// @brief the patterns in priority order
+    std::vector<RegexPatObj> patterns_;
+
+    /// @brief `tags_[i]` is the tag of `patterns_[i]`
+    std::vector<int> tags_;
+
+    /// @brief the union of all the patterns, accept states are tagged by pattern index
+    FSM::NFA nfa_;
+
+    /// @brief the combined dfa
+    FSM::DFA dfa_;
+
+    /// @brief the mapped cache file the loaded dfa points into, if any
+    std::shared_ptr<const void> mapping_;
 };
 
 /// @brief generate C = A{m}A*
@@ -2,12 +2,17 @@
 #define DRCC_SCANNER_H
 
 #include "tokenType.h"
+#include "identifiers.h"
 #include "regex/regex.h"
 
+#include <memory>
+
 
 namespace DRCC
 {
 
+class LexemeArena;
+
 /// @brief C scanner with a binded stream and a buffer
 ///        this project is designed to identift tokens with length 
 ///        no longer than `MAX_TOKEN` and `MAX_BUFFER`, if 256 is not enough, please
@@ -15,14 +20,33 @@ namespace DRCC
 class Scanner
 {
 private:
-    /// @brief input content
+    /// @brief streaming mode: the window of the input from the current token on
     std::string content;
 
+    /// @brief the bytes scanned: the input string, the mapped file or the streaming window
+    const char * text = "";
+
+    /// @brief owns the bytes the lexemes point into (the input string, the mapping or the
+    ///        lexeme copies of the streaming mode), shared with the AST
+    std::shared_ptr<const void> source_text;
+
+    /// @brief streaming mode: the lexemes copied out of the window, `nullptr` otherwise
+    std::shared_ptr<LexemeArena> lexemes;
+
+    /// @brief the identifiers scanned so far, by id
+    std::shared_ptr<IdentifierTable> identifier_table = std::make_shared<IdentifierTable>();
+
     int begin_pos = 0;
     int end_pos = 0;
 
-    /// @brief list of regex, identifying each token type
-    std::vector<std::pair<Regex::RegexPatObj, TokenType>> regexs;
+    /// @brief the stream refilling `content` in streaming mode, `nullptr` otherwise
+    std::istream * stream = nullptr;
+
+    /// @brief the bytes read from `stream` at a time
+    size_t chunk_size = 0;
+
+    /// @brief all the token regexs in priority order, matched by one combined automaton
+    Regex::RegexSet regexs;
 
 private:
 
@@ -33,17 +57,59 @@ private:
     void add_tokenizer(const char * const pat, TokenType token_type);
     void add_tokenizer(Regex::RegexPatObj regex, TokenType token_type);
 
+    /// @brief the longest token at `str`, by the generated direct-coded scanner if it is
+    ///        compiled in, by the token automaton otherwise
+    /// @param truncated : `true` if the token may go on after `length` bytes
+    int match_token(const char * const str, int length, int & token_type, bool & truncated) const;
+
+    /// @brief scan the `size` bytes at `data`, owned by `owner`
+    void set_text(std::shared_ptr<const void> owner, const char * data, size_t size);
+
+    /// @brief streaming mode: drop the bytes before the current token and read the next chunk,
+    ///        the window grows if a single token fills it
+    /// @return `false` if the stream is exhausted (or there is no stream)
+    bool refill();
+
 public:
     Scanner();
     Scanner(const std::string & input);
     Scanner(std::istream &is);
+
+    /// @brief streaming mode: the input is read in chunks while scanning, and only the bytes
+    ///        from the start of the current token on are kept
+    /// @param chunk_size : the bytes read at a time
+    Scanner(std::istream &is, size_t chunk_size);
     
+    /// @brief the default chunk size of the streaming mode
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 16;
+
+    /// @brief a scanner over the file open at `fd`, mapped into memory from its current offset
+    /// @return `nullptr` if `fd` is not a regular file or cannot be mapped
+    static std::unique_ptr<Scanner> map_file(int fd);
+
+    /// @brief the storage the lexemes point into, keep it to use the lexemes after the scanner
+    ///        is gone
+    std::shared_ptr<const void> source() const;
+
+    /// @brief the identifiers interned while scanning, the names point into `source`
+    std::shared_ptr<const IdentifierTable> identifiers() const;
+
     /// @brief the next token from the stream 
     Token next_token();
 
+    /// @brief the next tokens from the stream, up to `max_tokens` of them or through `END`
+    /// @return the number of tokens written to `out`
+    size_t next_tokens(Token * out, size_t max_tokens);
+
     /// @brief if there is no tokens left
     /// @return `true` if both the stream and the buffer exhausted
     bool empty();
+
+    /// @brief write a C++ source defining `DRCC::direct_scan`, the token automaton coded
+    ///        directly (see `Regex::RegexSet::emit_direct_matcher`), built with
+    ///        `-DDRCC_DIRECT_SCANNER` it replaces the automaton at runtime
+    /// @attention a scanner built with `-DDRCC_DIRECT_SCANNER` has no automaton to write
+    void generate_direct_scanner(std::ostream & os) const;
 };
 
 }
@@ -0,0 +1,116 @@
+#ifndef DRCC_SPSC_RING_H
+#define DRCC_SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace DRCC
+{
+
+/// @brief a bounded lock-free queue between one producer thread and one consumer thread,
+///        items move in batches and a full (empty) ring makes the producer (consumer) wait
+template<typename T>
+class SpscRing
+{
+private:
+    std::vector<T> slots_;
+    size_t mask_;
+
+    /// @brief the next slot to pop, written by the consumer only
+    alignas(64) std::atomic<size_t> head_;
+
+    /// @brief the next slot to push, written by the producer only
+    alignas(64) std::atomic<size_t> tail_;
+
+    /// @brief no more pushes (the producer is done) or pops (the consumer gave up)
+    alignas(64) std::atomic<bool> closed_;
+
+public:
+
+    /// @param capacity : rounded up to a power of 2
+    explicit SpscRing(size_t capacity)
+        : head_(0), tail_(0), closed_(false)
+    {
+        size_t size = 1;
+        while(size < capacity)
+        {
+            size <<= 1;
+        }
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    /// @brief producer: push the `n` items, waiting while the ring is full
+    /// @return `false` if the ring is closed before all of them are pushed
+    bool push(const T * items, size_t n)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        while(n > 0)
+        {
+            const size_t head = head_.load(std::memory_order_acquire);
+            const size_t room = std::min(n, slots_.size() - (tail - head));
+            if(room == 0)
+            {
+                if(closed_.load(std::memory_order_acquire))
+                {
+                    return false;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+
+            for(size_t i = 0; i < room; i++)
+            {
+                slots_[(tail + i) & mask_] = items[i];
+            }
+            tail += room;
+            items += room;
+            n -= room;
+            tail_.store(tail, std::memory_order_release);
+        }
+        return true;
+    }
+
+    /// @brief consumer: pop up to `max_items` into `out`, waiting while the ring is empty
+    /// @return the items popped, 0 only if the ring is closed and drained
+    size_t pop(T * out, size_t max_items)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        while(tail == head)
+        {
+            // the pushes before the close are visible once it is seen
+            if(closed_.load(std::memory_order_acquire))
+            {
+                tail = tail_.load(std::memory_order_acquire);
+                if(tail == head)
+                {
+                    return 0;
+                }
+                break;
+            }
+            std::this_thread::yield();
+            tail = tail_.load(std::memory_order_acquire);
+        }
+
+        const size_t n = std::min(max_items, tail - head);
+        for(size_t i = 0; i < n; i++)
+        {
+            out[i] = std::move(slots_[(head + i) & mask_]);
+        }
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    /// @brief wake and stop the other side: no more items are pushed, or popped
+    void close()
+    {
+        closed_.store(true, std::memory_order_release);
+    }
+};
+
+}
+
+#endif
@@ -45,6 +45,9 @@ enum NonTerminal
     exp10,  op10,
     exp11,  op11,
     exp12,  op12,
+
+    /// @brief not a symbol: the number of non-terminal symbols, keep it last
+    NONTERMINAL_COUNT,
 };
 
 /// @brief symbol wrapper
@@ -1,7 +1,10 @@
 #ifndef DRCC_TOKTYPE_H
 #define DRCC_TOKTYPE_H
 
+#include "identifiers.h"
+
 #include <string>
+#include <string_view>
 
 namespace DRCC
 {
@@ -25,7 +28,13 @@ enum TokenType
 struct Token
 {
     TokenType token_type;
-    std::string lexeme;
+
+    /// @brief the bytes of the token, owned by the scanner (see `Scanner::source`)
+    std::string_view lexeme;
+
+    /// @brief the interned id of an `ID` token (see `Scanner::identifiers`),
+    ///        `IdentifierTable::NO_ID` otherwise
+    int symbol_id = IdentifierTable::NO_ID;
 };
 
 
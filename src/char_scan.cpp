@@ -0,0 +1,213 @@
+#include "char_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DRCC_X86 1
+#include <immintrin.h>
+#endif
+
+
+namespace DRCC
+{
+
+namespace
+{
+
+inline bool is_whitespace(unsigned char ch)
+{
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+inline bool is_word(unsigned char ch)
+{
+    return (ch >= '0' && ch <= '9') || ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'z') || ch == '_';
+}
+
+inline bool is_digit(unsigned char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+// the scalar tails of the vector kernels, and the kernels on other machines
+template<bool (*in_class)(unsigned char)>
+size_t span_scalar(const char * const str, size_t pos, size_t length)
+{
+    while(pos < length && in_class(static_cast<unsigned char>(str[pos])))
+    {
+        pos++;
+    }
+    return pos;
+}
+
+size_t span_whitespace_scalar(const char * const str, size_t length)
+{
+    return span_scalar<is_whitespace>(str, 0, length);
+}
+
+size_t span_word_scalar(const char * const str, size_t length)
+{
+    return span_scalar<is_word>(str, 0, length);
+}
+
+size_t span_digits_scalar(const char * const str, size_t length)
+{
+    return span_scalar<is_digit>(str, 0, length);
+}
+
+#ifdef DRCC_X86
+
+// the classes are tested with signed compares: every member is below 0x80, so the bytes
+// that are negative as `char` never fall into a range
+
+// bytes in [lo, hi] are set to 0xff
+#define DRCC_IN_RANGE_128(x, lo, hi) \
+    _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8((lo) - 1)), _mm_cmplt_epi8(x, _mm_set1_epi8((hi) + 1)))
+
+#define DRCC_IN_RANGE_256(x, lo, hi) \
+    _mm256_andnot_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(lo), x), _mm256_cmpgt_epi8(_mm256_set1_epi8((hi) + 1), x))
+
+__attribute__((target("sse2")))
+inline __m128i whitespace_mask_128(__m128i x)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), DRCC_IN_RANGE_128(x, '\t', '\r'));
+}
+
+__attribute__((target("sse2")))
+inline __m128i word_mask_128(__m128i x)
+{
+    __m128i folded = _mm_or_si128(x, _mm_set1_epi8(0x20));
+    return _mm_or_si128(
+        _mm_or_si128(DRCC_IN_RANGE_128(x, '0', '9'), DRCC_IN_RANGE_128(folded, 'a', 'z')),
+        _mm_cmpeq_epi8(x, _mm_set1_epi8('_'))
+    );
+}
+
+__attribute__((target("sse2")))
+inline __m128i digit_mask_128(__m128i x)
+{
+    return DRCC_IN_RANGE_128(x, '0', '9');
+}
+
+__attribute__((target("avx2")))
+inline __m256i whitespace_mask_256(__m256i x)
+{
+    return _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), DRCC_IN_RANGE_256(x, '\t', '\r'));
+}
+
+__attribute__((target("avx2")))
+inline __m256i word_mask_256(__m256i x)
+{
+    __m256i folded = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+    return _mm256_or_si256(
+        _mm256_or_si256(DRCC_IN_RANGE_256(x, '0', '9'), DRCC_IN_RANGE_256(folded, 'a', 'z')),
+        _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_'))
+    );
+}
+
+__attribute__((target("avx2")))
+inline __m256i digit_mask_256(__m256i x)
+{
+    return DRCC_IN_RANGE_256(x, '0', '9');
+}
+
+// 16 bytes at a time: the first byte out of the class ends the run
+template<__m128i (*mask)(__m128i), bool (*in_class)(unsigned char)>
+__attribute__((target("sse2")))
+size_t span_sse2(const char * const str, size_t length)
+{
+    size_t pos = 0;
+    for(; pos + 16 <= length; pos += 16)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + pos));
+        unsigned out = ~static_cast<unsigned>(_mm_movemask_epi8(mask(x))) & 0xffffu;
+        if(out != 0)
+        {
+            return pos + __builtin_ctz(out);
+        }
+    }
+    return span_scalar<in_class>(str, pos, length);
+}
+
+// 32 bytes at a time
+template<__m256i (*mask)(__m256i), bool (*in_class)(unsigned char)>
+__attribute__((target("avx2")))
+size_t span_avx2(const char * const str, size_t length)
+{
+    size_t pos = 0;
+    for(; pos + 32 <= length; pos += 32)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(str + pos));
+        unsigned out = ~static_cast<unsigned>(_mm256_movemask_epi8(mask(x)));
+        if(out != 0)
+        {
+            return pos + __builtin_ctz(out);
+        }
+    }
+    return span_scalar<in_class>(str, pos, length);
+}
+
+#undef DRCC_IN_RANGE_128
+#undef DRCC_IN_RANGE_256
+
+#endif
+
+/// @brief the kernels of the best instruction set the cpu supports
+struct CharScanKernels
+{
+    size_t (*whitespace)(const char * const, size_t);
+    size_t (*word)(const char * const, size_t);
+    size_t (*digits)(const char * const, size_t);
+    const char * isa;
+
+    CharScanKernels()
+        : whitespace(span_whitespace_scalar), word(span_word_scalar), digits(span_digits_scalar),
+        isa("scalar")
+    {
+#ifdef DRCC_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+        {
+            whitespace = span_avx2<whitespace_mask_256, is_whitespace>;
+            word = span_avx2<word_mask_256, is_word>;
+            digits = span_avx2<digit_mask_256, is_digit>;
+            isa = "avx2";
+        }
+        else if(__builtin_cpu_supports("sse2"))
+        {
+            whitespace = span_sse2<whitespace_mask_128, is_whitespace>;
+            word = span_sse2<word_mask_128, is_word>;
+            digits = span_sse2<digit_mask_128, is_digit>;
+            isa = "sse2";
+        }
+#endif
+    }
+};
+
+const CharScanKernels & kernels()
+{
+    static const CharScanKernels instance;
+    return instance;
+}
+
+}
+
+size_t span_whitespace(const char * const str, size_t length)
+{
+    return kernels().whitespace(str, length);
+}
+
+size_t span_word(const char * const str, size_t length)
+{
+    return kernels().word(str, length);
+}
+
+size_t span_digits(const char * const str, size_t length)
+{
+    return kernels().digits(str, length);
+}
+
+const char * char_scan_isa()
+{
+    return kernels().isa;
+}
+
+}
@@ -6,11 +6,11 @@
 namespace DRCC
 {
 
-void WarningIfExist(const std::string & id, const std::map<std::string, int> & M)
+void WarningIfExist(const ASTNode & id, const std::vector<int> & symbol_table)
 {
-    if(M.find(id) != M.end())
+    if(symbol_table[id.symbol_id] != 0)
     {
-        std::cerr << "[Warning] Multiple declaration of variable \"" << id << "\"\n";
+        std::cerr << "[Warning] Multiple declaration of variable \"" << id.lexeme << "\"\n";
     }
 }
 
@@ -26,10 +26,10 @@ int hexval(char c)
 }
 
 /// @brief Helper funtion lexeme -> int
-int to_integer(const char * const s)
+int to_integer(std::string_view s)
 {
-    int length = std::strlen(s);
-    const char * str = s;
+    int length = s.size();
+    const char * str = s.data();
     int base = 10;
 
     if(s[0] == '0')
@@ -37,7 +37,7 @@ int to_integer(const char * const s)
         if(length > 2 && s[1] == 'x')
         {
             base = 16;
-            str = s + 2;
+            str = s.data() + 2;
             length -= 2;
         }
         else
@@ -107,8 +107,8 @@ void mipsCodeGen::cgen_(std::shared_ptr<ASTNode> node_ptr, int nt, std::ostream
         break;
 
     case 7: // declaration -> ID, ASSIGN, INT_NUM
-        os << "\tli\t\t$a0, " << to_integer(node_ptr->children[2]->lexeme.c_str()) << "\n";
-        os << "\tsw\t\t$a0, " << symbol_table[node_ptr->children[0]->lexeme] << "($fp)\n";
+        os << "\tli\t\t$a0, " << to_integer(node_ptr->children[2]->lexeme) << "\n";
+        os << "\tsw\t\t$a0, " << symbol_table[node_ptr->children[0]->symbol_id] << "($fp)\n";
         break;
 
     case 8: // declaration -> ID, LSQUARE, INT_NUM, RSQUARE
@@ -297,7 +297,7 @@ void mipsCodeGen::cgen_(std::shared_ptr<ASTNode> node_ptr, int nt, std::ostream
         os << "\tsw\t\t$a0, " << -4 * nt << "($fp)\n";
         cgen_(node_ptr->children[5], nt + 1, os);
         os << "\tlw\t\t$t1, " << -4 * nt << "($fp)\n";
-        os << "\tsw\t\t$a0, " << symbol_table[node_ptr->children[0]->lexeme] << "($t1)\n";
+        os << "\tsw\t\t$a0, " << symbol_table[node_ptr->children[0]->symbol_id] << "($t1)\n";
         break;
 
     case 32: // assign_stmt -> ID, ASSIGN, exp
@@ -307,7 +307,7 @@ void mipsCodeGen::cgen_(std::shared_ptr<ASTNode> node_ptr, int nt, std::ostream
          * 
          */
         cgen_(node_ptr->children[2], nt, os);
-        os << "\tsw\t\t$a0, " << symbol_table[node_ptr->children[0]->lexeme] << "($fp)\n";
+        os << "\tsw\t\t$a0, " << symbol_table[node_ptr->children[0]->symbol_id] << "($fp)\n";
         break;
 
     case 33: // do_while_stmt -> DO, statement, WHILE, LPAR, exp, RPAR
@@ -342,7 +342,7 @@ void mipsCodeGen::cgen_(std::shared_ptr<ASTNode> node_ptr, int nt, std::ostream
          * 
          */
         os << "\tli\t\t$v0, 5\n\tsyscall\n";
-        os << "\tsw\t\t$v0, " << symbol_table[node_ptr->children[2]->lexeme] << "($fp)\n";
+        os << "\tsw\t\t$v0, " << symbol_table[node_ptr->children[2]->symbol_id] << "($fp)\n";
         break;
 
     case 36: // write_stmt -> WRITE, LPAR, exp, RPAR
@@ -718,7 +718,7 @@ void mipsCodeGen::cgen_(std::shared_ptr<ASTNode> node_ptr, int nt, std::ostream
         /**
          *      li      $a0, INT_VAL
          */
-        int_value = to_integer(node_ptr->children[0]->lexeme.c_str());
+        int_value = to_integer(node_ptr->children[0]->lexeme);
         os << "\tli\t\t$a0, " << int_value << "\n";
         break;
 
@@ -726,7 +726,7 @@ void mipsCodeGen::cgen_(std::shared_ptr<ASTNode> node_ptr, int nt, std::ostream
         /**
          *      lw      $a0, Offset_ID($fp)
          */
-        offset = symbol_table[node_ptr->children[0]->lexeme];
+        offset = symbol_table[node_ptr->children[0]->symbol_id];
         os << "\tlw\t\t$a0, " << offset << "($fp)\n";
         break;
 
@@ -737,7 +737,7 @@ void mipsCodeGen::cgen_(std::shared_ptr<ASTNode> node_ptr, int nt, std::ostream
          *      addu    $a0, $a0, $fp
          *      lw      $a0, Offset_ID($a0)
          */
-        offset = symbol_table[node_ptr->children[0]->lexeme];
+        offset = symbol_table[node_ptr->children[0]->symbol_id];
         cgen_(node_ptr->children[2], nt, os);
         os << "\tsll\t\t$a0, $a0, 2\n";
         os << "\taddu\t$a0, $a0, $fp\n";
@@ -811,20 +811,20 @@ void mipsCodeGen::build_symbol_table_(std::shared_ptr<ASTNode> node_ptr)
         break;
 
     case 7: // declaration -> ID, ASSIGN, INT_NUM
-        WarningIfExist(node_ptr->children[0]->lexeme, symbol_table);
-        symbol_table[node_ptr->children[0]->lexeme] = tot_offset;
+        WarningIfExist(*node_ptr->children[0], symbol_table);
+        symbol_table[node_ptr->children[0]->symbol_id] = tot_offset;
         tot_offset += 4;
         break;
 
     case 8: // declaration -> ID, LSQUARE, INT_NUM, RSQUARE
-        WarningIfExist(node_ptr->children[0]->lexeme, symbol_table);
-        symbol_table[node_ptr->children[0]->lexeme] = tot_offset;
-        tot_offset += 4 * to_integer(node_ptr->children[2]->lexeme.c_str());
+        WarningIfExist(*node_ptr->children[0], symbol_table);
+        symbol_table[node_ptr->children[0]->symbol_id] = tot_offset;
+        tot_offset += 4 * to_integer(node_ptr->children[2]->lexeme);
         break;
 
     case 9: // declaration -> ID
-        WarningIfExist(node_ptr->children[0]->lexeme, symbol_table);
-        symbol_table[node_ptr->children[0]->lexeme] = tot_offset;
+        WarningIfExist(*node_ptr->children[0], symbol_table);
+        symbol_table[node_ptr->children[0]->symbol_id] = tot_offset;
         tot_offset += 4;
         break;
 
@@ -838,6 +838,7 @@ mipsCodeGen::mipsCodeGen(std::shared_ptr<ASTNode> node_ptr)
 {
     if(node_ptr != nullptr)
     {
+        symbol_table.assign(node_ptr->identifiers != nullptr ? node_ptr->identifiers->size() : 0, 0);
         build_symbol_table_(node_ptr);
         fprintf(stderr, "size = %d [Bytes] = %d KB \n", tot_offset, tot_offset / 1024);
     }
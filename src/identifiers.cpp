@@ -0,0 +1,26 @@
+#include "identifiers.h"
+
+namespace DRCC
+{
+
+int IdentifierTable::intern(std::string_view name)
+{
+    auto inserted = ids.emplace(name, names.size());
+    if(inserted.second)
+    {
+        names.push_back(name);
+    }
+    return inserted.first->second;
+}
+
+std::string_view IdentifierTable::name(int id) const
+{
+    return names[id];
+}
+
+int IdentifierTable::size() const
+{
+    return names.size();
+}
+
+}
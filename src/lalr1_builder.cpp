@@ -0,0 +1,299 @@
+/**
+ * @file lalr1_builder.cpp
+ * @brief The LALR(1) collection of the grammar: the LR(0) automaton, with the lookaheads of
+ *        its reduce items computed by the relations of DeRemer and Pennello (reads, includes
+ *        and lookback). Like lr1_builder.cpp it is not linked with the generated tables
+ */
+
+#include <algorithm>
+#include <bitset>
+#include <climits>
+#include <iostream>
+
+#include "parser.h"
+
+namespace DRCC
+{
+
+namespace
+{
+
+/// @brief an LR(0) item: the production and the position of the dot
+typedef std::pair<int, int> LR0Item;
+
+/// @brief the digraph algorithm: sets[x] = sets[x] | the sets of all y with x R y, the
+///        strongly connected components of R end up sharing one set
+class Digraph
+{
+private:
+    const std::vector<std::vector<int>> & relation_;
+    std::vector<TerminalSet> & sets_;
+    std::vector<int> depth_;
+    std::vector<int> stack_;
+
+    void traverse_(int x)
+    {
+        stack_.push_back(x);
+        const int depth = stack_.size();
+        depth_[x] = depth;
+
+        for(int y : relation_[x])
+        {
+            if(depth_[y] == 0)
+            {
+                traverse_(y);
+            }
+            depth_[x] = std::min(depth_[x], depth_[y]);
+            sets_[x] |= sets_[y];
+        }
+
+        // x is the root of a component: its members are done
+        if(depth_[x] == depth)
+        {
+            int top;
+            do
+            {
+                top = stack_.back();
+                stack_.pop_back();
+                depth_[top] = INT_MAX;
+                sets_[top] = sets_[x];
+            } while(top != x);
+        }
+    }
+
+public:
+    Digraph(const std::vector<std::vector<int>> & relation, std::vector<TerminalSet> & sets)
+        : relation_(relation), sets_(sets), depth_(sets.size(), 0)
+    {
+
+    }
+
+    void run()
+    {
+        for(size_t x = 0; x < sets_.size(); x++)
+        {
+            if(depth_[x] == 0)
+            {
+                traverse_(x);
+            }
+        }
+    }
+};
+
+}
+
+bool Parser::_construct_lalr1_items()
+{
+    auto nullable = [this](Symbol symb) {
+        return ! symb.is_terminal() && _first_set[symb].count(NOTOK) != 0;
+    };
+
+    // the LR(0) automaton, the states are told apart by their kernels
+    std::vector<std::vector<LR0Item>> states;
+    std::vector<std::map<Symbol, int>> next;
+    std::map<std::vector<LR0Item>, int> state_idx;
+
+    auto add_state = [&](const std::vector<LR0Item> & kernel) {
+        auto found = state_idx.find(kernel);
+        if(found != state_idx.end())
+        {
+            return found->second;
+        }
+
+        std::vector<LR0Item> items = kernel;
+        std::set<LR0Item> seen(kernel.begin(), kernel.end());
+        for(size_t i = 0; i < items.size(); i++)
+        {
+            const Production & prod = grammar[items[i].first];
+            if(items[i].second >= static_cast<int>(prod.rhs.size()))
+            {
+                continue;
+            }
+
+            auto candidates = _gmap.find(prod.rhs[items[i].second]);
+            if(candidates == _gmap.end())
+            {
+                continue;
+            }
+            for(int prod_idx : candidates->second)
+            {
+                if(seen.insert({ prod_idx, 0 }).second)
+                {
+                    items.push_back({ prod_idx, 0 });
+                }
+            }
+        }
+
+        state_idx[kernel] = states.size();
+        states.push_back(items);
+        next.emplace_back();
+        return static_cast<int>(states.size()) - 1;
+    };
+
+    add_state({ { 0, 0 } });
+    for(size_t i = 0; i < states.size(); i++)
+    {
+        std::map<Symbol, std::vector<LR0Item>> kernels;
+        for(const LR0Item & item : states[i])
+        {
+            const Production & prod = grammar[item.first];
+            if(item.second < static_cast<int>(prod.rhs.size()))
+            {
+                kernels[prod.rhs[item.second]].push_back({ item.first, item.second + 1 });
+            }
+        }
+
+        for(auto & kv : kernels)
+        {
+            std::sort(kv.second.begin(), kv.second.end());
+            int to = add_state(kv.second);
+            next[i][kv.first] = to;
+        }
+    }
+
+    // the non-terminal transitions (p, A)
+    std::vector<std::pair<int, Symbol>> transitions;
+    std::map<std::pair<int, Symbol>, int> transition_idx;
+    for(size_t p = 0; p < states.size(); p++)
+    {
+        for(const auto & kv : next[p])
+        {
+            if(! kv.first.is_terminal())
+            {
+                transition_idx[{ static_cast<int>(p), kv.first }] = transitions.size();
+                transitions.push_back({ p, kv.first });
+            }
+        }
+    }
+    const int num_transitions = transitions.size();
+
+    // DR(p, A): the terminals read right after the transition, END after the start symbol;
+    // (p, A) reads (r, C) if r = GOTO(p, A) and C is nullable
+    std::vector<TerminalSet> read_sets(num_transitions);
+    std::vector<std::vector<int>> reads(num_transitions);
+    for(int x = 0; x < num_transitions; x++)
+    {
+        const int r = next[transitions[x].first].at(transitions[x].second);
+        for(const auto & kv : next[r])
+        {
+            if(kv.first.is_terminal())
+            {
+                read_sets[x].set(kv.first.symbol_value());
+            }
+            else if(nullable(kv.first))
+            {
+                reads[x].push_back(transition_idx.at({ r, kv.first }));
+            }
+        }
+
+        for(const LR0Item & item : states[r])
+        {
+            if(item.first == 0 && item.second == 1)
+            {
+                read_sets[x].set(END);
+            }
+        }
+    }
+    Digraph(reads, read_sets).run();
+
+    // (p', B) includes (p, A) if B -> b A c, c is nullable and p' goes to p by b, and the
+    // reduction of B -> w in q looks back at (p', B) if p' goes to q by w
+    std::vector<std::vector<int>> includes(num_transitions);
+    std::map<std::pair<int, int>, std::vector<int>> lookback;
+    for(int x = 0; x < num_transitions; x++)
+    {
+        const int p = transitions[x].first;
+        for(int prod_idx : _gmap[transitions[x].second])
+        {
+            const std::vector<Symbol> & rhs = grammar[prod_idx].rhs;
+            int q = p;
+            for(size_t i = 0; i < rhs.size(); i++)
+            {
+                bool nullable_rest = true;
+                for(size_t j = i + 1; j < rhs.size() && nullable_rest; j++)
+                {
+                    nullable_rest = nullable(rhs[j]);
+                }
+                if(! rhs[i].is_terminal() && nullable_rest)
+                {
+                    includes[transition_idx.at({ q, rhs[i] })].push_back(x);
+                }
+                q = next[q].at(rhs[i]);
+            }
+            lookback[{ q, prod_idx }].push_back(x);
+        }
+    }
+
+    // Follow(p, A) = Read(p, A) and the Follow sets of all it includes
+    std::vector<TerminalSet> & follow_sets = read_sets;
+    Digraph(includes, follow_sets).run();
+
+    // LA(q, A -> w): the Follow sets looked back at, the start production is followed by END
+    std::vector<std::vector<std::pair<int, TerminalSet>>> reductions(states.size());
+    int num_conflicts = 0;
+    for(size_t q = 0; q < states.size(); q++)
+    {
+        TerminalSet reduced;
+        bool conflict = false;
+        for(const LR0Item & item : states[q])
+        {
+            if(item.second != static_cast<int>(grammar[item.first].rhs.size()))
+            {
+                continue;
+            }
+
+            TerminalSet lookaheads;
+            if(item.first == 0)
+            {
+                lookaheads.set(END);
+            }
+            for(int x : lookback[{ static_cast<int>(q), item.first }])
+            {
+                lookaheads |= follow_sets[x];
+            }
+
+            conflict = conflict || (reduced & lookaheads).any();
+            reduced |= lookaheads;
+            reductions[q].push_back({ item.first, lookaheads });
+        }
+        num_conflicts += conflict;
+    }
+
+    // only merged states can have reduce/reduce conflicts canonical LR(1) does not have
+    if(num_conflicts != 0)
+    {
+        std::cerr << "LALR(1): reduce/reduce conflicts in " << num_conflicts \
+            << " states, using canonical LR(1)" << std::endl;
+        return false;
+    }
+
+    _lr1_items.assign(states.size(), LR1ItemSet());
+    _goto_archive.clear();
+    for(size_t q = 0; q < states.size(); q++)
+    {
+        for(const auto & kv : next[q])
+        {
+            _goto_archive[q][kv.first] = kv.second;
+        }
+        for(const auto & reduction : reductions[q])
+        {
+            const int position = grammar[reduction.first].rhs.size();
+            for(int t = 0; t < NUM_TERMINALS; t++)
+            {
+                if(reduction.second.test(t))
+                {
+                    _lr1_items[q].add(LR1Item(reduction.first, position, static_cast<Terminal>(t)));
+                }
+            }
+        }
+    }
+    _lr1_items[0].add(LR1Item(0, 0, END));
+    for(LR1ItemSet & items : _lr1_items)
+    {
+        items.seal();
+    }
+
+    return true;
+}
+
+}
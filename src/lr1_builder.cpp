@@ -0,0 +1,633 @@
+/**
+ * @file lr1_builder.cpp
+ * @brief The construction of the LR(1) parsing tables of the grammar. A compiler built with
+ *        `-DDRCC_GENERATED_TABLES` runs on the tables written by `Parser::generate_tables`
+ *        instead, and does not link this file
+ */
+
+#include <queue>
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+
+#include "parser.h"
+
+namespace DRCC
+{
+
+namespace
+{
+
+/// @brief row-displacement packing: the entry of row `r` at column `c` goes to
+///        `value[base[r] + c]`, and `check` there is `r`. The rows are placed first fit, the
+///        densest first, and `num_columns` slots of padding keep every lookup in bounds
+template<typename T>
+void pack_rows(const std::vector<std::vector<std::pair<int, T>>> & rows, int num_columns,
+    std::vector<int> & base, std::vector<int> & check, std::vector<T> & value)
+{
+    std::vector<int> order(rows.size());
+    for(size_t r = 0; r < rows.size(); r++)
+    {
+        order[r] = r;
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&rows](int lhs, int rhs) { return rows[lhs].size() > rows[rhs].size(); });
+
+    base.assign(rows.size(), 0);
+    check.clear();
+    value.clear();
+    for(int r : order)
+    {
+        int offset = 0;
+        for(bool fits = false; ! fits && ! rows[r].empty(); offset += ! fits)
+        {
+            fits = true;
+            for(const auto & entry : rows[r])
+            {
+                size_t slot = offset + entry.first;
+                if(slot < check.size() && check[slot] != -1)
+                {
+                    fits = false;
+                    break;
+                }
+            }
+        }
+
+        base[r] = offset;
+        for(const auto & entry : rows[r])
+        {
+            size_t slot = offset + entry.first;
+            if(slot >= check.size())
+            {
+                check.resize(slot + 1, -1);
+                value.resize(slot + 1, T());
+            }
+            check[slot] = r;
+            value[slot] = entry.second;
+        }
+    }
+
+    check.resize(check.size() + num_columns, -1);
+    value.resize(value.size() + num_columns, T());
+}
+
+/// @brief write `values` as a constexpr array of the generated tables
+template<typename T>
+void emit_array(std::ostream & os, const char * type, const char * name, const std::vector<T> & values)
+{
+    os << "constexpr " << type << " " << name << "[] = {";
+    for(size_t i = 0; i < values.size(); i++)
+    {
+        os << (i % 16 == 0 ? "\n    " : " ");
+        if(std::is_enum<T>::value)
+        {
+            os << type << "(" << static_cast<int>(values[i]) << "),";
+        }
+        else
+        {
+            os << values[i] << ",";
+        }
+    }
+    os << "\n};\n\n";
+}
+
+}
+
+// initialization of the parser
+void Parser::init()
+{
+    this->grammar = c_grammar();
+    
+    // construct gmap
+    for(int i = 0; i < this->grammar.size(); i++)
+    {
+        _gmap[grammar[i].lhs].push_back(i);
+    }
+
+    for(auto & i : this->grammar)
+    {
+        symbols.insert(i.lhs);
+        for(auto & j: i.rhs)
+        {
+            symbols.insert(j);
+        }
+    }
+
+    for(auto symb : symbols)
+    {
+        if(symb.is_terminal())
+        {
+            _terminals.insert(symb);
+        }
+        else
+        {
+            _nonterminals.insert(symb);
+        }
+    }
+    _terminals.emplace(END);
+
+    _compute_first_set();
+    if(construction != TableConstruction::LALR1 || ! _construct_lalr1_items())
+    {
+        _construct_cannonical_lr1_items();
+    }
+    _construct_lr1_parsing_table();
+    _pack_parsing_table();
+
+}
+
+
+// print action & goto table (for debug purpose)
+void Parser::print_table()
+{
+    // no code
+}
+
+LR1Item::LR1Item(int prod_idx, int position, Terminal lookahead)
+    : prod_idx(prod_idx), position(position), lookahead(lookahead)
+{
+
+}
+
+LR1Item::LR1Item(uint64_t key)
+    : prod_idx(key >> 32), position(key >> 16 & 0xffff), lookahead(static_cast<Terminal>(key & 0xffff))
+{
+
+}
+
+uint64_t LR1Item::key() const
+{
+    return static_cast<uint64_t>(prod_idx) << 32 | static_cast<uint64_t>(position) << 16 | lookahead;
+}
+
+void LR1ItemSet::add(const LR1Item & item)
+{
+    keys.push_back(item.key());
+}
+
+void LR1ItemSet::seal()
+{
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    hash = keys.size();
+    for(uint64_t key : keys)
+    {
+        hash = (hash ^ key ^ key >> 29) * 0x9e3779b97f4a7c15ull;
+    }
+}
+
+size_t LR1ItemSet::size() const
+{
+    return keys.size();
+}
+
+bool LR1ItemSet::operator==(const LR1ItemSet & rhs) const
+{
+    return hash == rhs.hash && keys == rhs.keys;
+}
+
+bool Parser::_first_of(const std::vector<Symbol> & rhs, size_t from, TerminalSet & first)
+{
+    for(size_t i = from; i < rhs.size(); i++)
+    {
+        bool nullable = false;
+        for(Terminal b : _first_set[rhs[i]])
+        {
+            if(b == NOTOK)
+            {
+                nullable = true;
+                continue;
+            }
+            first.set(b);
+        }
+
+        if(! nullable)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+const std::vector<ClosureItem> & Parser::_nonterminal_closure(Symbol B)
+{
+    auto found = _closure_cache.find(B);
+    if(found != _closure_cache.end())
+    {
+        return found->second;
+    }
+
+    // the closure of [A -> a . B b, #], # standing for FIRST(b x) of any item closed
+    std::map<int, std::pair<TerminalSet, bool>> items;
+    std::queue<int> work_list;
+    for(int prod_idx : _gmap[B])
+    {
+        items[prod_idx].second = true;
+        work_list.push(prod_idx);
+    }
+
+    while(! work_list.empty())
+    {
+        const int cur = work_list.front();
+        work_list.pop();
+
+        const std::vector<Symbol> & rhs = grammar[cur].rhs;
+        if(rhs.empty() || rhs[0].is_terminal())
+        {
+            continue;
+        }
+
+        TerminalSet lookaheads;
+        bool propagated = false;
+        if(_first_of(rhs, 1, lookaheads))
+        {
+            lookaheads |= items[cur].first;
+            propagated = items[cur].second;
+        }
+
+        for(int prod_idx : _gmap[rhs[0]])
+        {
+            auto inserted = items.emplace(prod_idx, std::make_pair(TerminalSet(), false));
+            auto & item = inserted.first->second;
+            if(inserted.second || (lookaheads & ~item.first).any() || (propagated && ! item.second))
+            {
+                item.first |= lookaheads;
+                item.second = item.second || propagated;
+                work_list.push(prod_idx);
+            }
+        }
+    }
+
+    std::vector<ClosureItem> & closure = _closure_cache[B];
+    for(const auto & kv : items)
+    {
+        closure.push_back({ kv.first, kv.second.first, kv.second.second });
+    }
+    return closure;
+}
+
+std::map<int, TerminalSet> Parser::make_closure(const LR1ItemSet & kernel)
+{
+    // FIRST(b x) of the kernel items [A -> a . B b, x], gathered by B
+    std::map<Symbol, TerminalSet> propagated;
+    for(uint64_t key : kernel.keys)
+    {
+        const LR1Item item(key);
+        const std::vector<Symbol> & rhs = grammar[item.prod_idx].rhs;
+        if(item.position >= rhs.size() || rhs[item.position].is_terminal())
+        {
+            continue;
+        }
+
+        TerminalSet & lookaheads = propagated[rhs[item.position]];
+        if(_first_of(rhs, item.position + 1, lookaheads))
+        {
+            lookaheads.set(item.lookahead);
+        }
+    }
+
+    std::map<int, TerminalSet> closure;
+    for(const auto & kv : propagated)
+    {
+        for(const ClosureItem & item : _nonterminal_closure(kv.first))
+        {
+            TerminalSet & lookaheads = closure[item.prod_idx];
+            lookaheads |= item.spontaneous;
+            if(item.propagated)
+            {
+                lookaheads |= kv.second;
+            }
+        }
+    }
+    return closure;
+}
+
+void Parser::_construct_cannonical_lr1_items()
+{
+    LR1ItemSet s;
+    s.add(LR1Item(0, 0, END));
+    s.seal();
+
+    _lr1_item_idx[s] = _lr1_items.size();
+    _lr1_items.push_back(s);
+
+    for(int i = 0; i < _lr1_items.size(); i++)
+    {
+        // the kernels of GOTO(I_i, X), for the symbols X after a dot
+        std::map<Symbol, LR1ItemSet> kernels;
+        for(uint64_t key : _lr1_items[i].keys)
+        {
+            LR1Item item(key);
+            const std::vector<Symbol> & rhs = grammar[item.prod_idx].rhs;
+            if(item.position < rhs.size())
+            {
+                item.position += 1;
+                kernels[rhs[item.position - 1]].add(item);
+            }
+        }
+
+        for(const auto & kv : make_closure(_lr1_items[i]))
+        {
+            const std::vector<Symbol> & rhs = grammar[kv.first].rhs;
+            if(rhs.empty())
+            {
+                continue;
+            }
+
+            LR1ItemSet & J = kernels[rhs[0]];
+            for(int t = 0; t < NUM_TERMINALS; t++)
+            {
+                if(kv.second.test(t))
+                {
+                    J.add(LR1Item(kv.first, 1, static_cast<Terminal>(t)));
+                }
+            }
+        }
+
+        for(auto & kv : kernels)
+        {
+            kv.second.seal();
+            auto inserted = _lr1_item_idx.emplace(kv.second, _lr1_items.size());
+            if(inserted.second)
+            {
+                _lr1_items.push_back(std::move(kv.second));
+            }
+            _goto_archive[i][kv.first] = inserted.first->second;
+        }
+    }
+       
+}
+
+void Parser::_compute_first_set()
+{
+    for(Symbol symb : _terminals)
+    {
+        _first_set[symb].insert(static_cast<Terminal>(symb.symbol_value()));
+    }
+
+    for(Symbol symb : _nonterminals)
+    {
+        if(_gmap.count(symb) == 0)
+        {
+            std::cerr << "Help!" << std::endl;
+            continue;
+        }
+
+        for(int prod_idx : _gmap[symb])
+        {
+            if(grammar[prod_idx].rhs.size() == 0)
+            {
+                _first_set[symb].insert(NOTOK);
+            }
+        }
+    }
+
+    bool changed = true; // loop until no changes.
+    while(changed)
+    {
+        changed = false;
+        for(const auto & g : grammar)
+        {
+            Symbol symb = g.lhs;
+            int origin_size = _first_set[symb].size();
+            bool nullable = true;
+
+            for(Symbol rsymb : g.rhs)
+            {
+                _first_set[symb].insert(_first_set[rsymb].begin(), _first_set[rsymb].end());
+
+                if(_first_set[rsymb].count(NOTOK) == 0)
+                {
+                    nullable = false;
+                    break;
+                }
+            }
+
+            if(nullable)
+            {
+                _first_set[symb].insert(NOTOK);
+            }
+
+            changed = changed || (_first_set[symb].size() != origin_size);
+        }
+    }
+
+}
+
+void Parser::_construct_lr1_parsing_table()
+{
+    for(int i = 0; i < _lr1_items.size(); i++)
+    {
+        auto &action_row = __action_transition_tab[i];
+        auto & goto_row = _goto_transition_tab[i];
+        auto GOTO_entry = _goto_archive[i];
+
+        // compute shift action
+        for(const auto & kv : GOTO_entry)
+        {
+            if(kv.second == -1)
+            {
+                continue;
+            }
+
+            if(kv.first.is_terminal())
+            {
+                ActionEntry ae = {
+                    .action = ActionEntryEnum::SHIFT, 
+                    .target = kv.second,
+                };
+                Terminal t = kv.first.as_terminal();
+                
+                action_row[t] = ae;
+            }
+            else
+            {
+                goto_row[kv.first.as_nonterminal()] = kv.second;
+            }
+        }
+
+        // compute reduce action, the closure items reduce by the empty productions
+        std::vector<uint64_t> reduce_items = _lr1_items[i].keys;
+        for(const auto & kv : make_closure(_lr1_items[i]))
+        {
+            for(int t = 0; t < NUM_TERMINALS; t++)
+            {
+                if(grammar[kv.first].rhs.empty() && kv.second.test(t))
+                {
+                    reduce_items.push_back(LR1Item(kv.first, 0, static_cast<Terminal>(t)).key());
+                }
+            }
+        }
+
+        for(uint64_t key : reduce_items)
+        {
+            const LR1Item items(key);
+            auto &g = grammar[items.prod_idx];
+            if(g.lhs == goal)
+            {
+                if(items.lookahead == END && items.position == 0)
+                {
+                    initial_state = i;
+                }
+                if(items.lookahead == END && items.position == 1)
+                {
+                    action_row[END] = { .action = ActionEntryEnum::ACCEPT };
+                }
+            }
+
+            if(items.position < g.rhs.size())
+            {
+                continue;
+            }
+
+            // report conflicts
+            if(action_row.count(items.lookahead) != 0)
+            {
+                if(action_row[items.lookahead].action == ActionEntryEnum::SHIFT)
+                {
+                    std::cerr << "Shift/reduce conflict!" << std::endl;
+                }
+                else if(action_row[items.lookahead].target != items.prod_idx)
+                {
+                    std::cerr << "Reduce/reduce conflict!" << std::endl;
+                }
+                continue;
+            }
+            
+            // set to reduce
+            action_row[items.lookahead] = {
+                .action = ActionEntryEnum::REDUCE,
+                .target = items.prod_idx
+            };
+
+        }
+    }
+
+
+}
+
+void Parser::_pack_parsing_table()
+{
+    const int num_states = _lr1_items.size();
+
+    // the ACTION rows without the entries of their default reduction
+    std::vector<std::vector<std::pair<int, PackedAction>>> action_rows(num_states);
+    _default_action.assign(num_states, pack_action(ActionEntryEnum::ERROR, 0));
+    for(int i = 0; i < num_states; i++)
+    {
+        std::map<int, int> reductions;
+        for(const auto & kv : __action_transition_tab[i])
+        {
+            if(kv.second.action == ActionEntryEnum::REDUCE)
+            {
+                reductions[kv.second.target]++;
+            }
+        }
+
+        auto best = std::max_element(reductions.begin(), reductions.end(),
+            [](const auto & lhs, const auto & rhs) { return lhs.second < rhs.second; });
+        if(best != reductions.end())
+        {
+            _default_action[i] = pack_action(ActionEntryEnum::REDUCE, best->first);
+        }
+
+        for(const auto & kv : __action_transition_tab[i])
+        {
+            PackedAction entry = pack_action(kv.second.action, kv.second.target);
+            if(entry != _default_action[i])
+            {
+                action_rows[i].emplace_back(kv.first, entry);
+            }
+        }
+    }
+    pack_rows(action_rows, NUM_TERMINALS, _action_base, _action_check, _action);
+
+    // the GOTO columns without the entries of their most frequent target
+    std::vector<std::vector<std::pair<int, int>>> goto_columns(NUM_NONTERMINALS);
+    _default_goto.assign(NUM_NONTERMINALS, -1);
+    for(int A = 0; A < NUM_NONTERMINALS; A++)
+    {
+        std::map<int, int> targets;
+        for(int i = 0; i < num_states; i++)
+        {
+            auto found = _goto_transition_tab[i].find(static_cast<NonTerminal>(A));
+            if(found != _goto_transition_tab[i].end())
+            {
+                targets[found->second]++;
+            }
+        }
+
+        auto best = std::max_element(targets.begin(), targets.end(),
+            [](const auto & lhs, const auto & rhs) { return lhs.second < rhs.second; });
+        if(best != targets.end())
+        {
+            _default_goto[A] = best->first;
+        }
+
+        for(int i = 0; i < num_states; i++)
+        {
+            auto found = _goto_transition_tab[i].find(static_cast<NonTerminal>(A));
+            if(found != _goto_transition_tab[i].end() && found->second != _default_goto[A])
+            {
+                goto_columns[A].emplace_back(i, found->second);
+            }
+        }
+    }
+    pack_rows(goto_columns, num_states, _goto_base, _goto_check, _goto_state);
+
+    _rhs_length.clear();
+    _lhs.clear();
+    for(const Production & prod : grammar)
+    {
+        _rhs_length.push_back(prod.rhs.size());
+        _lhs.push_back(prod.lhs.as_nonterminal());
+    }
+
+    tables = {
+        .num_states = num_states,
+        .initial_state = initial_state,
+        .action_base = _action_base.data(),
+        .action_check = _action_check.data(),
+        .action = _action.data(),
+        .default_action = _default_action.data(),
+        .goto_base = _goto_base.data(),
+        .goto_check = _goto_check.data(),
+        .goto_state = _goto_state.data(),
+        .default_goto = _default_goto.data(),
+        .rhs_length = _rhs_length.data(),
+        .lhs = _lhs.data(),
+    };
+}
+
+void Parser::generate_tables(std::ostream & os) const
+{
+    os << "// generated by Parser::generate_tables, do not edit\n\n";
+    os << "#include \"parser.h\"\n\n";
+    os << "namespace DRCC\n{\n\n";
+    os << "static_assert(NUM_TERMINALS == " << NUM_TERMINALS << " && NUM_NONTERMINALS == " \
+        << NUM_NONTERMINALS << ", \"the symbols changed, regenerate the tables\");\n\n";
+    os << "namespace\n{\n\n";
+
+    emit_array(os, "int", "action_base", _action_base);
+    emit_array(os, "int", "action_check", _action_check);
+    emit_array(os, "PackedAction", "action", _action);
+    emit_array(os, "PackedAction", "default_action", _default_action);
+    emit_array(os, "int", "goto_base", _goto_base);
+    emit_array(os, "int", "goto_check", _goto_check);
+    emit_array(os, "int", "goto_state", _goto_state);
+    emit_array(os, "int", "default_goto", _default_goto);
+    emit_array(os, "int", "rhs_length", _rhs_length);
+    emit_array(os, "NonTerminal", "lhs", _lhs);
+
+    os << "}\n\n";
+    os << "extern const ParseTables generated_parse_tables = {\n";
+    os << "    " << tables.num_states << ", " << tables.initial_state << ",\n";
+    os << "    action_base, action_check, action, default_action,\n";
+    os << "    goto_base, goto_check, goto_state, default_goto,\n";
+    os << "    rhs_length, lhs,\n";
+    os << "};\n\n";
+    os << "}\n";
+}
+
+}
@@ -5,17 +5,26 @@
 
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <unistd.h>
 
 // Durable and Rubust C Compiler (Derong C Compiler)
 using namespace DRCC;
 
 int main(int argc, char **argv)
 {
+    // the input is mapped if it is redirected from a file, streamed otherwise
+    std::unique_ptr<Scanner> scanner = Scanner::map_file(STDIN_FILENO);
+    if(scanner == nullptr)
+    {
+        scanner = std::make_unique<Scanner>(std::cin, Scanner::DEFAULT_CHUNK_SIZE);
+    }
+
     // the parser take the owership of its scanner
-    Parser parser(std::make_unique<Scanner>(std::cin));
+    Parser parser(std::move(scanner));
 
-    // parsing
-    auto root = parser.parse();
+    // parsing, with the scanner on a thread of its own if there is a core to spare
+    auto root = parser.parse(std::thread::hardware_concurrency() > 1);
     // export the parse tree in the form of graphviz file
     if(argc == 2)
     {
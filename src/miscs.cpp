@@ -117,7 +117,7 @@ void export_graphviz_(std::shared_ptr<ASTNode> node_ptr, std::ostream &os)
     os << "\t\t" << (long long) node_ptr.get() \
         << "[label=\"" \
         << (node_ptr->symbol.is_terminal()
-            ? to_string(node_ptr->symbol) + '(' + node_ptr->lexeme + ')'
+            ? to_string(node_ptr->symbol) + '(' + std::string(node_ptr->lexeme) + ')'
             : to_string(node_ptr->symbol)
         ) \
         << "\"] ;\n";
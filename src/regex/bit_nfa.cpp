@@ -0,0 +1,191 @@
+#include "regex/fsm.h"
+
+#include <array>
+
+namespace FSM
+{
+
+BitParallelNFA::BitParallelNFA()
+    : num_positions_(0), num_chunks_(0), follow_table_(),
+    byte_mask_(DFA::ALPHABET_SIZE, 0), accept_mask_(0), tags_()
+{
+
+}
+
+int BitParallelNFA::size() const
+{
+    return num_positions_;
+}
+
+// A position is a pair (q, L): nfa state q entered by a byte of L from some state. Two
+// edges into q with different byte sets are different positions, so that the bytes
+// entering a position do not depend on where it is entered from (the Glushkov property):
+// next = follow(now) & byte_mask[ch] is then exact.
+bool BitParallelNFA::build(const NFA & nfa)
+{
+    using Label = std::array<uint64_t, 4>;
+
+    *this = BitParallelNFA();
+
+    // labels_of[s][q]: the bytes moving state s to state q
+    std::vector<std::map<int, Label>> labels_of(nfa.size());
+    for(int state = 0; state < nfa.size(); state++)
+    {
+        for(const auto & kv : nfa.transitions(state))
+        {
+            // '\0' marks the lambda moves
+            if(kv.first == '\0')
+            {
+                continue;
+            }
+
+            const unsigned char ch = kv.first;
+            for(int to : kv.second)
+            {
+                Label & label = labels_of[state][to];
+                label[ch >> 6] |= uint64_t(1) << (ch & 63);
+            }
+        }
+    }
+
+    // number the positions, 0 is the start state
+    std::map<std::pair<int, Label>, int> position_idx;
+    std::vector<std::pair<int, Label>> positions = { { nfa.start_state(), Label() } };
+    for(int state = 0; state < nfa.size(); state++)
+    {
+        for(const auto & kv : labels_of[state])
+        {
+            auto key = std::make_pair(kv.first, kv.second);
+            if(position_idx.count(key) == 0)
+            {
+                if(static_cast<int>(positions.size()) >= MAX_POSITIONS)
+                {
+                    *this = BitParallelNFA();
+                    return false;
+                }
+                position_idx.emplace(key, positions.size());
+                positions.push_back(key);
+            }
+        }
+    }
+
+    num_positions_ = positions.size();
+    num_chunks_ = (num_positions_ + 7) / 8;
+    tags_.assign(num_positions_, NFA::NO_TAG);
+
+    std::vector<uint64_t> follow(num_positions_, 0);
+    std::vector<int> closure;
+    for(int pos = 0; pos < num_positions_; pos++)
+    {
+        const uint64_t bit = uint64_t(1) << pos;
+        const Label & label = positions[pos].second;
+        for(int ch = 1; ch < DFA::ALPHABET_SIZE; ch++)
+        {
+            if(label[ch >> 6] >> (ch & 63) & 1)
+            {
+                byte_mask_[ch] |= bit;
+            }
+        }
+
+        // what can be entered from the closure of the state, and if it is accepted
+        nfa.lambda_closure(positions[pos].first, closure);
+        for(int state : closure)
+        {
+            for(const auto & kv : labels_of[state])
+            {
+                follow[pos] |= uint64_t(1) << position_idx.at(std::make_pair(kv.first, kv.second));
+            }
+
+            int tag = nfa.accept_tag(state);
+            if(nfa.is_accept_state(state))
+            {
+                accept_mask_ |= bit;
+            }
+            if(tag != NFA::NO_TAG && (tags_[pos] == NFA::NO_TAG || tag < tags_[pos]))
+            {
+                tags_[pos] = tag;
+            }
+        }
+    }
+
+    // the union of the follow sets of any byte of the position set, chunk by chunk
+    follow_table_.assign(static_cast<size_t>(num_chunks_) * 256, 0);
+    for(int k = 0; k < num_chunks_; k++)
+    {
+        uint64_t * const table = &follow_table_[static_cast<size_t>(k) * 256];
+        for(int b = 1; b < 256; b++)
+        {
+            int low = __builtin_ctz(b);
+            int pos = 8 * k + low;
+            table[b] = table[b & (b - 1)] | (pos < num_positions_ ? follow[pos] : 0);
+        }
+    }
+
+    return true;
+}
+
+uint64_t BitParallelNFA::follow_(uint64_t set) const
+{
+    uint64_t ans = 0;
+    const uint64_t * table = follow_table_.data();
+    for(int k = 0; k < num_chunks_; k++, set >>= 8, table += 256)
+    {
+        ans |= table[set & 0xff];
+    }
+    return ans;
+}
+
+int BitParallelNFA::max_accept_length(const char * const s, int max_length) const
+{
+    int tag = NFA::NO_TAG;
+    return max_accept_length(s, max_length, tag);
+}
+
+int BitParallelNFA::max_accept_length(const char * const s, int max_length, int & tag) const
+{
+    // not built: nothing can be matched
+    if(num_positions_ == 0)
+    {
+        return 0;
+    }
+
+    int max_ans = 0;
+    uint64_t now = 1;
+    uint64_t last_accept = 0;
+
+    for(int i = 0; i < max_length; i++)
+    {
+        now = follow_(now) & byte_mask_[static_cast<unsigned char>(s[i])];
+
+        // no position is alive: the matching fails
+        if(now == 0)
+        {
+            break;
+        }
+
+        if(now & accept_mask_)
+        {
+            max_ans = i + 1;
+            last_accept = now & accept_mask_;
+        }
+    }
+
+    // the smallest tag of the accept positions at the end of the match
+    if(last_accept != 0)
+    {
+        int best = NFA::NO_TAG;
+        for(; last_accept != 0; last_accept &= last_accept - 1)
+        {
+            int pos_tag = tags_[__builtin_ctzll(last_accept)];
+            if(pos_tag != NFA::NO_TAG && (best == NFA::NO_TAG || pos_tag < best))
+            {
+                best = pos_tag;
+            }
+        }
+        tag = best;
+    }
+
+    return max_ans;
+}
+
+}
@@ -0,0 +1,569 @@
+#include "regex/regex.h"
+
+#include <algorithm>
+
+namespace Regex
+{
+
+NFABuilder::NFABuilder()
+    : nfa_(0, 0), pattern_(), pos_(0), error_()
+{
+
+}
+
+NFABuilder::Fragment NFABuilder::new_fragment_()
+{
+    int start = nfa_.add_state();
+    int accept = nfa_.add_state();
+    return Fragment { start, accept, start, accept };
+}
+
+NFABuilder::Fragment NFABuilder::empty()
+{
+    Fragment frag = new_fragment_();
+    nfa_.add_transition(frag.start, '\0', frag.accept);
+    return frag;
+}
+
+NFABuilder::Fragment NFABuilder::literal(const std::string & str)
+{
+    int start = nfa_.add_state();
+    int now = start;
+    for(char ch : str)
+    {
+        int next = nfa_.add_state();
+        nfa_.add_transition(now, ch, next);
+        now = next;
+    }
+    return Fragment { start, now, start, now };
+}
+
+NFABuilder::Fragment NFABuilder::char_set(const std::set<char> & acc_char_set)
+{
+    Fragment frag = new_fragment_();
+    for(char acc_char : acc_char_set)
+    {
+        nfa_.add_transition(frag.start, acc_char, frag.accept);
+    }
+    return frag;
+}
+
+NFABuilder::Fragment NFABuilder::range(char range_first, char range_last)
+{
+    if(range_last < range_first)
+    {
+        std::swap(range_last, range_first);
+    }
+
+    Fragment frag = new_fragment_();
+    for(int ch = range_first; ch <= range_last; ch++)
+    {
+        nfa_.add_transition(frag.start, static_cast<char>(ch), frag.accept);
+    }
+    return frag;
+}
+
+NFABuilder::Fragment NFABuilder::concat(const Fragment & lhs, const Fragment & rhs)
+{
+    nfa_.add_transition(lhs.accept, '\0', rhs.start);
+    return Fragment { lhs.start, rhs.accept, std::min(lhs.first, rhs.first), std::max(lhs.last, rhs.last) };
+}
+
+NFABuilder::Fragment NFABuilder::alternate(const Fragment & lhs, const Fragment & rhs)
+{
+    Fragment frag = new_fragment_();
+    nfa_.add_transition(frag.start, '\0', lhs.start);
+    nfa_.add_transition(frag.start, '\0', rhs.start);
+    nfa_.add_transition(lhs.accept, '\0', frag.accept);
+    nfa_.add_transition(rhs.accept, '\0', frag.accept);
+    frag.first = std::min(lhs.first, rhs.first);
+    return frag;
+}
+
+NFABuilder::Fragment NFABuilder::star(const Fragment & frag)
+{
+    Fragment ret = new_fragment_();
+    nfa_.add_transition(ret.start, '\0', frag.start);
+    nfa_.add_transition(ret.start, '\0', ret.accept);
+    nfa_.add_transition(frag.accept, '\0', frag.start);
+    nfa_.add_transition(frag.accept, '\0', ret.accept);
+    ret.first = frag.first;
+    return ret;
+}
+
+NFABuilder::Fragment NFABuilder::plus(const Fragment & frag)
+{
+    Fragment ret = new_fragment_();
+    nfa_.add_transition(ret.start, '\0', frag.start);
+    nfa_.add_transition(frag.accept, '\0', frag.start);
+    nfa_.add_transition(frag.accept, '\0', ret.accept);
+    ret.first = frag.first;
+    return ret;
+}
+
+NFABuilder::Fragment NFABuilder::optional(const Fragment & frag)
+{
+    Fragment ret = new_fragment_();
+    nfa_.add_transition(ret.start, '\0', frag.start);
+    nfa_.add_transition(ret.start, '\0', ret.accept);
+    nfa_.add_transition(frag.accept, '\0', ret.accept);
+    ret.first = frag.first;
+    return ret;
+}
+
+// copy the state range of the fragment, transitions leaving the range belong to other
+// fragments sharing the range and are dropped
+NFABuilder::Fragment NFABuilder::copy(const Fragment & frag)
+{
+    const int offset = nfa_.size() - frag.first;
+    nfa_.reserve(nfa_.size() + frag.last - frag.first + 1);
+    for(int state = frag.first; state <= frag.last; state++)
+    {
+        nfa_.add_state();
+    }
+
+    for(int state = frag.first; state <= frag.last; state++)
+    {
+        for(const auto & kv : nfa_.transitions(state))
+        {
+            for(int to : kv.second)
+            {
+                if(to >= frag.first && to <= frag.last)
+                {
+                    nfa_.add_transition(state + offset, kv.first, to + offset);
+                }
+            }
+        }
+    }
+
+    return Fragment { frag.start + offset, frag.accept + offset, frag.first + offset, frag.last + offset };
+}
+
+// A{m,n} = A...A (m times) followed by (A(A(...)?)?)? (n - m times), or A* if unbounded;
+// all copies are made before anything is linked
+NFABuilder::Fragment NFABuilder::repeat(const Fragment & frag, int min_times, int max_times)
+{
+    int num_copies = max_times < 0 ? min_times + 1 : max_times;
+    if(num_copies == 0)
+    {
+        return empty();
+    }
+
+    std::vector<Fragment> copies = { frag };
+    for(int i = 1; i < num_copies; i++)
+    {
+        copies.push_back(copy(frag));
+    }
+
+    // the optional tail, built from the back
+    Fragment tail = copies.back();
+    bool has_tail = false;
+    if(max_times < 0)
+    {
+        tail = star(copies.back());
+        has_tail = true;
+    }
+    else if(max_times > min_times)
+    {
+        tail = optional(copies.back());
+        for(int i = max_times - 2; i >= min_times; i--)
+        {
+            tail = optional(concat(copies[i], tail));
+        }
+        has_tail = true;
+    }
+
+    if(min_times == 0)
+    {
+        return tail;
+    }
+
+    Fragment ret = copies[0];
+    for(int i = 1; i < min_times; i++)
+    {
+        ret = concat(ret, copies[i]);
+    }
+
+    return has_tail ? concat(ret, tail) : ret;
+}
+
+int NFABuilder::size() const
+{
+    return nfa_.size();
+}
+
+FSM::NFA NFABuilder::build(const Fragment & frag)
+{
+    nfa_.set_start_state(frag.start);
+    nfa_.add_accept_state(frag.accept);
+
+    FSM::NFA ret(std::move(nfa_));
+    nfa_ = FSM::NFA(0, 0);
+    return ret;
+}
+
+const std::string & NFABuilder::error() const
+{
+    return error_;
+}
+
+bool NFABuilder::fail_(const std::string & reason)
+{
+    error_ = reason + " at position " + std::to_string(pos_) + " of \"" + pattern_ + "\"";
+    return false;
+}
+
+bool NFABuilder::parse(const std::string & pattern, Fragment & frag)
+{
+    pattern_ = pattern;
+    pos_ = 0;
+    error_.clear();
+
+    if(! parse_alternation_(frag))
+    {
+        return false;
+    }
+
+    if(pos_ != pattern_.size())
+    {
+        return fail_("unmatched ')'");
+    }
+
+    return true;
+}
+
+// alternation := concatenation ('|' concatenation)*
+bool NFABuilder::parse_alternation_(Fragment & frag)
+{
+    if(! parse_concatenation_(frag))
+    {
+        return false;
+    }
+
+    while(pos_ < pattern_.size() && pattern_[pos_] == '|')
+    {
+        pos_++;
+        Fragment rhs;
+        if(! parse_concatenation_(rhs))
+        {
+            return false;
+        }
+        frag = alternate(frag, rhs);
+    }
+
+    return true;
+}
+
+// concatenation := repetition*
+bool NFABuilder::parse_concatenation_(Fragment & frag)
+{
+    bool any = false;
+    while(pos_ < pattern_.size() && pattern_[pos_] != '|' && pattern_[pos_] != ')')
+    {
+        Fragment next;
+        if(! parse_repetition_(next))
+        {
+            return false;
+        }
+        frag = any ? concat(frag, next) : next;
+        any = true;
+    }
+
+    if(! any)
+    {
+        frag = empty();
+    }
+
+    return true;
+}
+
+// repetition := atom ('*' | '+' | '?' | '{' m (',' n?)? '}')*
+bool NFABuilder::parse_repetition_(Fragment & frag)
+{
+    if(! parse_atom_(frag))
+    {
+        return false;
+    }
+
+    while(pos_ < pattern_.size())
+    {
+        char op = pattern_[pos_];
+        if(op == '*')
+        {
+            frag = star(frag);
+        }
+        else if(op == '+')
+        {
+            frag = plus(frag);
+        }
+        else if(op == '?')
+        {
+            frag = optional(frag);
+        }
+        else if(op == '{')
+        {
+            pos_++;
+            int min_times = 0, max_times = 0;
+            if(! parse_number_(min_times))
+            {
+                return false;
+            }
+
+            max_times = min_times;
+            if(pos_ < pattern_.size() && pattern_[pos_] == ',')
+            {
+                pos_++;
+                max_times = -1;
+                if(pos_ < pattern_.size() && pattern_[pos_] != '}' && ! parse_number_(max_times))
+                {
+                    return false;
+                }
+            }
+
+            if(pos_ >= pattern_.size() || pattern_[pos_] != '}')
+            {
+                return fail_("expected '}'");
+            }
+
+            if(max_times >= 0 && max_times < min_times)
+            {
+                return fail_("invalid repetition range");
+            }
+
+            frag = repeat(frag, min_times, max_times);
+        }
+        else
+        {
+            break;
+        }
+        pos_++;
+    }
+
+    return true;
+}
+
+bool NFABuilder::parse_number_(int & value)
+{
+    size_t begin = pos_;
+    value = 0;
+    while(pos_ < pattern_.size() && pattern_[pos_] >= '0' && pattern_[pos_] <= '9')
+    {
+        value = value * 10 + (pattern_[pos_] - '0');
+        if(value > 100000)
+        {
+            return fail_("repetition count too large");
+        }
+        pos_++;
+    }
+
+    if(pos_ == begin)
+    {
+        return fail_("expected a number");
+    }
+    return true;
+}
+
+namespace
+{
+
+/// @brief the characters of an escape class (`\d`, `\w`, `\s`), empty if `ch` is not one
+std::set<char> escape_class(char ch)
+{
+    std::set<char> chars;
+    if(ch == 'd' || ch == 'w')
+    {
+        for(char c = '0'; c <= '9'; c++) chars.insert(c);
+    }
+    if(ch == 'w')
+    {
+        for(char c = 'a'; c <= 'z'; c++) chars.insert(c);
+        for(char c = 'A'; c <= 'Z'; c++) chars.insert(c);
+        chars.insert('_');
+    }
+    if(ch == 's')
+    {
+        chars = { ' ', '\t', '\n', '\r', '\v', '\f' };
+    }
+    return chars;
+}
+
+/// @brief the character an escape stands for
+char escape_char(char ch)
+{
+    switch (ch)
+    {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    case '0': return '\0';
+    default: return ch;
+    }
+}
+
+}
+
+// atom := char | '.' | '\' char | set | '(' alternation ')'
+bool NFABuilder::parse_atom_(Fragment & frag)
+{
+    char ch = pattern_[pos_];
+    switch (ch)
+    {
+    case '(':
+        pos_++;
+        if(! parse_alternation_(frag))
+        {
+            return false;
+        }
+        if(pos_ >= pattern_.size() || pattern_[pos_] != ')')
+        {
+            return fail_("expected ')'");
+        }
+        pos_++;
+        return true;
+
+    case '[':
+        return parse_set_(frag);
+
+    case '.':
+    {
+        // any byte but the line break ('\0' marks the lambda moves)
+        frag = new_fragment_();
+        for(int c = 1; c < 256; c++)
+        {
+            if(c != '\n')
+            {
+                nfa_.add_transition(frag.start, static_cast<char>(c), frag.accept);
+            }
+        }
+        pos_++;
+        return true;
+    }
+
+    case '*': case '+': case '?': case '{':
+        return fail_("nothing to repeat");
+
+    case '\\':
+    {
+        if(++pos_ >= pattern_.size())
+        {
+            return fail_("trailing '\\'");
+        }
+
+        std::set<char> chars = escape_class(pattern_[pos_]);
+        char lit = escape_char(pattern_[pos_]);
+        if(chars.empty() && lit == '\0')
+        {
+            return fail_("'\\0' cannot be matched");
+        }
+        frag = chars.empty() ? literal(std::string(1, lit)) : char_set(chars);
+        pos_++;
+        return true;
+    }
+
+    default:
+        frag = literal(std::string(1, ch));
+        pos_++;
+        return true;
+    }
+}
+
+// set := '[' '^'? (char ('-' char)?)+ ']', a ']' right after the '[' is a member
+bool NFABuilder::parse_set_(Fragment & frag)
+{
+    pos_++;
+    bool negated = false;
+    if(pos_ < pattern_.size() && pattern_[pos_] == '^')
+    {
+        negated = true;
+        pos_++;
+    }
+
+    std::set<char> chars;
+    bool first = true;
+    while(pos_ < pattern_.size() && (pattern_[pos_] != ']' || first))
+    {
+        first = false;
+
+        // a single member, possibly escaped
+        auto member = [this](char & c, std::set<char> & cls) {
+            cls.clear();
+            if(pattern_[pos_] == '\\' && pos_ + 1 < pattern_.size())
+            {
+                pos_++;
+                cls = escape_class(pattern_[pos_]);
+                c = escape_char(pattern_[pos_]);
+            }
+            else
+            {
+                c = pattern_[pos_];
+            }
+            pos_++;
+        };
+
+        char low, high;
+        std::set<char> cls;
+        member(low, cls);
+        if(! cls.empty())
+        {
+            chars.insert(cls.begin(), cls.end());
+            continue;
+        }
+
+        high = low;
+        if(pos_ + 1 < pattern_.size() && pattern_[pos_] == '-' && pattern_[pos_ + 1] != ']')
+        {
+            pos_++;
+            member(high, cls);
+            if(! cls.empty() || static_cast<unsigned char>(high) < static_cast<unsigned char>(low))
+            {
+                return fail_("invalid range in set");
+            }
+        }
+
+        for(int c = static_cast<unsigned char>(low); c <= static_cast<unsigned char>(high); c++)
+        {
+            chars.insert(static_cast<char>(c));
+        }
+    }
+
+    if(pos_ >= pattern_.size())
+    {
+        return fail_("expected ']'");
+    }
+    pos_++;
+
+    // '\0' marks the lambda moves and is never matched
+    std::set<char> members;
+    for(int c = 1; c < 256; c++)
+    {
+        if(chars.count(static_cast<char>(c)) != static_cast<size_t>(! negated))
+        {
+            continue;
+        }
+        members.insert(static_cast<char>(c));
+    }
+
+    frag = char_set(members);
+    return true;
+}
+
+bool RegexParse(const std::string & pattern, RegexPatObj & regex, std::string * error)
+{
+    NFABuilder builder;
+    NFABuilder::Fragment frag;
+    if(! builder.parse(pattern, frag))
+    {
+        if(error != nullptr)
+        {
+            *error = builder.error();
+        }
+        return false;
+    }
+
+    regex = RegexPatObj(builder.build(frag));
+    return true;
+}
+
+}
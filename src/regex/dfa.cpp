@@ -1,136 +1,776 @@
 #include "regex/fsm.h"
 
 #include <cstdio>
-#include <queue>
+#include <cstring>
+#include <algorithm>
 
 namespace FSM 
 {
 
-DFA::DFA(const NFA &nfa)
-    : nfa_p(&nfa), num_states_(0), start_state_(-1),
-    accept_states_(), transitions_(), nfa_used_(false), from_nfa_(true)
+DFA::DFA(const NFA &nfa, bool minimize)
+    : nfa_p(&nfa), minimize_enabled_(minimize), num_states_(0), num_raw_states_(0), start_state_(-1),
+    accept_states_(), num_classes_(1), byte_class_(ALPHABET_SIZE, 0),
+    transitions_(), table_(), accept_map_(),
+    byte_class_p(nullptr), table_p(nullptr), accept_map_p(nullptr), accept_tag_map_p(nullptr),
+    loaded_(false), nfa_used_(false), from_nfa_(true)
 {
     
 }
 
+DFA::DFA(const DFA & src)
+    : DFA(*src.nfa_p, src.minimize_enabled_)
+{
+    *this = src;
+}
+
+DFA::DFA(DFA && src)
+    : DFA(*src.nfa_p, src.minimize_enabled_)
+{
+    *this = std::move(src);
+}
+
 void DFA::build()
 {
     // build the DFA if not yet built
     if(from_nfa_ && nfa_used_ == false)
     {
         build_from_nfa_();
+        num_raw_states_ = num_states_;
+
+        if(minimize_enabled_)
+        {
+            minimize_();
+        }
+
+        compile_table_();
     }
     
 }
 
+void DFA::set_minimize(bool minimize)
+{
+    minimize_enabled_ = minimize;
+}
 
-/// @brief Using a bfs simulates the transition on NFA to generate DFA
-void DFA::build_from_nfa_()
+int DFA::size() const
 {
+    return num_states_;
+}
 
-    // BFS queue
-    std::queue<StateSet> state_queue;
-    std::map<StateSet, int> dfa_map;
+int DFA::unminimized_size() const
+{
+    return num_raw_states_;
+}
 
-    // the start state of the DFA is the lambda-closure of the start state of NFA
-    const StateSet & nfa_start_states = nfa_p->lambda_closure(nfa_p->start_state());
-    dfa_map[nfa_start_states] = num_states_++;
-    state_queue.push(nfa_start_states);
+int DFA::num_byte_classes() const
+{
+    return num_classes_;
+}
+
+int32_t DFA::start_state() const
+{
+    return start_state_;
+}
+
+int DFA::byte_class(unsigned char ch) const
+{
+    return byte_class_p[ch];
+}
+
+int32_t DFA::next_state(int32_t state, int c) const
+{
+    return table_p[static_cast<size_t>(state) * num_classes_ + c];
+}
+
+bool DFA::is_accept_state(int32_t state) const
+{
+    return accept_map_p[state] != 0;
+}
+
+int32_t DFA::accept_tag(int32_t state) const
+{
+    return accept_tag_map_p[state];
+}
+
+
+namespace
+{
 
-    while(! state_queue.empty())
+typedef uint64_t word_t;
+constexpr int WORD_BITS = 64;
+
+/// @brief a hash-consed arena of equally sized bitsets, each distinct set gets a dense id
+class BitsetPool
+{
+public:
+
+    explicit BitsetPool(int words)
+        : words_(words), bits_(), index_()
     {
-        StateSet cur_closure = state_queue.front();
-        state_queue.pop();
 
+    }
+
+    /// @brief the id of `set`, inserting it if it is new
+    /// @return (id, `true` if the set is inserted)
+    std::pair<int, bool> intern(const word_t * set)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for(int i = 0; i < words_; i++)
+        {
+            hash = (hash ^ set[i]) * 1099511628211ULL;
+        }
 
-        // simulate the transition on NFA
-        for(char ch = 1; ch > 0; ch++)
+        auto range = index_.equal_range(hash);
+        for(auto iter = range.first; iter != range.second; ++iter)
         {
-            StateSet next_states, next_closure;
-            
-            // the set of state reached from 1 ch-move
-            for(int state : cur_closure)
+            if(std::equal(set, set + words_, get(iter->second)))
             {
-                const auto & partial = nfa_p->transitions(state).find(ch);
-                
-                if(partial == nfa_p->transitions(state).end())
+                return std::make_pair(iter->second, false);
+            }
+        }
+
+        int id = size();
+        bits_.insert(bits_.end(), set, set + words_);
+        index_.emplace(hash, id);
+        return std::make_pair(id, true);
+    }
+
+    const word_t * get(int id) const
+    {
+        return bits_.data() + static_cast<size_t>(id) * words_;
+    }
+
+    int size() const
+    {
+        return bits_.size() / words_;
+    }
+
+private:
+
+    int words_;
+
+    /// @brief all the sets, back to back
+    std::vector<word_t> bits_;
+
+    /// @brief hash -> ids of the sets with that hash
+    std::unordered_multimap<uint64_t, int> index_;
+};
+
+/// @brief call `fn(state)` for every bit set in `set`
+template<typename Fn>
+void for_each_bit(const word_t * set, int words, Fn fn)
+{
+    for(int i = 0; i < words; i++)
+    {
+        for(word_t w = set[i]; w != 0; w &= w - 1)
+        {
+            fn(i * WORD_BITS + __builtin_ctzll(w));
+        }
+    }
+}
+
+}
+
+/// @brief Using a bfs simulates the transition on NFA to generate DFA, the closures are
+///        dense bitsets over the nfa states and interned so that each is stored once
+void DFA::build_from_nfa_()
+{
+    const int n = nfa_p->size();
+    const int words = (n + WORD_BITS - 1) / WORD_BITS;
+
+    // the lambda closure and the accept flag of every nfa state as bitsets
+    std::vector<word_t> closure_bits(static_cast<size_t>(n) * words, 0);
+    std::vector<word_t> accept_bits(words, 0);
+    std::vector<int> closure;
+    for(int state = 0; state < n; state++)
+    {
+        word_t * dst = closure_bits.data() + static_cast<size_t>(state) * words;
+        nfa_p->lambda_closure(state, closure);
+        for(int s : closure)
+        {
+            dst[s / WORD_BITS] |= word_t(1) << (s % WORD_BITS);
+        }
+        if(nfa_p->is_accept_state(state))
+        {
+            accept_bits[state / WORD_BITS] |= word_t(1) << (state % WORD_BITS);
+        }
+    }
+
+    num_classes_ = nfa_p->byte_classes(byte_class_);
+
+    // the smallest byte of each class stands for the whole class
+    std::vector<int> class_repr(num_classes_, -1);
+    for(int ch = ALPHABET_SIZE - 1; ch >= 0; ch--)
+    {
+        class_repr[byte_class_[ch]] = ch;
+    }
+
+    BitsetPool pool(words);
+
+    // the start state of the DFA is the lambda-closure of the start state of NFA
+    start_state_ = pool.intern(closure_bits.data() + static_cast<size_t>(nfa_p->start_state()) * words).first;
+
+    // scratch: the closure reached by each byte class, only for the classes on outgoing edges
+    std::vector<word_t> next_bits(static_cast<size_t>(num_classes_) * words, 0);
+    std::vector<int> touched;
+    std::vector<bool> seen(num_classes_, false);
+
+    // the pool grows while being scanned, so its ids double as the BFS queue
+    for(int cur = 0; cur < pool.size(); cur++)
+    {
+        // simulate the transition on NFA: the set of states reached from 1 ch-move
+        // and several lambda-moves, for every class leaving the current closure
+        for_each_bit(pool.get(cur), words, [&](int state) {
+            for(const auto & kv : nfa_p->transitions(state))
+            {
+                unsigned char ch = kv.first;
+                int c = byte_class_[ch];
+
+                // the other bytes of the class lead to the same states
+                if(kv.first == '\0' || class_repr[c] != ch)
                 {
                     continue;
                 }
 
-                next_states.insert(partial->second.begin(), partial->second.end());
+                if(! seen[c])
+                {
+                    seen[c] = true;
+                    touched.push_back(c);
+                }
+
+                word_t * dst = next_bits.data() + static_cast<size_t>(c) * words;
+                for(int to : kv.second)
+                {
+                    const word_t * partial = closure_bits.data() + static_cast<size_t>(to) * words;
+                    for(int i = 0; i < words; i++)
+                    {
+                        dst[i] |= partial[i];
+                    }
+                }
             }
+        });
+
+        std::sort(touched.begin(), touched.end());
+        for(int c : touched)
+        {
+            word_t * next_closure = next_bits.data() + static_cast<size_t>(c) * words;
+
+            // if the state is not explored, it gets the next id and is visited later
+            transitions_[cur][c] = pool.intern(next_closure).first;
+
+            std::fill(next_closure, next_closure + words, 0);
+            seen[c] = false;
+        }
+        touched.clear();
+    }
+
+    num_states_ = pool.size();
 
-            if(next_states.empty())
+    // the accept state of DFA is all the states containing one accept state of the NFA,
+    // tagged by the smallest tag among them
+    for(int id = 0; id < num_states_; id++)
+    {
+        const word_t * closure = pool.get(id);
+        bool accepted = false;
+        int tag = NFA::NO_TAG;
+        for(int i = 0; i < words; i++)
+        {
+            word_t hit = closure[i] & accept_bits[i];
+            for(; hit != 0; hit &= hit - 1)
             {
-                continue;
+                accepted = true;
+                int state_tag = nfa_p->accept_tag(i * WORD_BITS + __builtin_ctzll(hit));
+                if(state_tag != NFA::NO_TAG && (tag == NFA::NO_TAG || state_tag < tag))
+                {
+                    tag = state_tag;
+                }
             }
+        }
 
-            // build the set of states reached from 1 ch-move and several lambda-moves
-            for(int state : next_states)
+        if(accepted)
+        {
+            accept_states_.insert(id);
+            accept_tags_[id] = tag;
+        }
+    }
+}
+
+/// @brief Hopcroft's algorithm: start from {accept, non-accept} and split blocks by the
+///        predecessors of a splitter until the partition is stable. Missing transitions
+///        go to an explicit dead state, whose block is dropped afterwards.
+void DFA::minimize_()
+{
+    if(num_states_ <= 1)
+    {
+        return ;
+    }
+
+    const int dead = num_states_;
+    const int n = num_states_ + 1;
+
+    // the alphabet that actually appears in the transitions
+    std::map<int, int> symbol_idx;
+    for(const auto & row : transitions_)
+    {
+        for(const auto & kv : row.second)
+        {
+            symbol_idx.emplace(kv.first, 0);
+        }
+    }
+    int num_symbols = 0;
+    for(auto & kv : symbol_idx)
+    {
+        kv.second = num_symbols++;
+    }
+
+    // inverse transitions: inverse[c][t] are the states reaching t by symbol c
+    std::vector<std::vector<std::vector<int>>> inverse(num_symbols, std::vector<std::vector<int>>(n));
+    for(int state = 0; state < n; state++)
+    {
+        const auto row = (state == dead) ? transitions_.end() : transitions_.find(state);
+        for(const auto & kv : symbol_idx)
+        {
+            int to = dead;
+            if(row != transitions_.end())
             {
-                const StateSet & partial = nfa_p->lambda_closure(state);
-                next_closure.insert(partial.begin(), partial.end());
+                const auto iter = row->second.find(kv.first);
+                if(iter != row->second.end())
+                {
+                    to = iter->second;
+                }
             }
+            inverse[kv.second][to].push_back(state);
+        }
+    }
 
-            // if the state is not explored, then push into queue
-            if(dfa_map.count(next_closure) == 0)
+    // initial partition: non-accept states / accept states grouped by their tags
+    std::vector<std::vector<int>> blocks(1);
+    std::vector<int> block_of(n);
+    std::map<int, int> block_of_tag;
+    for(int state = 0; state < n; state++)
+    {
+        int b = 0;
+        if(accept_states_.count(state))
+        {
+            auto iter = block_of_tag.find(accept_tags_.at(state));
+            if(iter == block_of_tag.end())
             {
-                dfa_map[next_closure] = num_states_++;
-                state_queue.push(next_closure);
+                iter = block_of_tag.emplace(accept_tags_.at(state), blocks.size()).first;
+                blocks.emplace_back();
             }
+            b = iter->second;
+        }
+        block_of[state] = b;
+        blocks[b].push_back(state);
+    }
 
-            transitions_[dfa_map[cur_closure]][ch] = dfa_map[next_closure];
+    if(blocks.size() == 1)
+    {
+        return ;
+    }
+
+    // every initial block but the largest one is a splitter
+    int largest = 0;
+    for(int b = 1; b < (int) blocks.size(); b++)
+    {
+        if(blocks[b].size() > blocks[largest].size())
+        {
+            largest = b;
+        }
+    }
 
+    std::vector<int> worklist;
+    std::vector<bool> in_worklist(blocks.size(), false);
+    for(int b = 0; b < (int) blocks.size(); b++)
+    {
+        if(b != largest)
+        {
+            worklist.push_back(b);
+            in_worklist[b] = true;
         }
     }
 
+    std::vector<bool> marked(n, false);
+    std::vector<int> touched_blocks;
+    std::vector<std::vector<int>> marked_of(blocks.size());
 
-    // the accept state of DFA is all the states containing one accept state of the NFA
-    for(const auto & closure : dfa_map)
+    while(! worklist.empty())
     {
-        for(int state : closure.first)
+        const std::vector<int> splitter = blocks[worklist.back()];
+        in_worklist[worklist.back()] = false;
+        worklist.pop_back();
+
+        for(int c = 0; c < num_symbols; c++)
         {
-            if(nfa_p->is_accept_state(state))
+            // mark the predecessors of the splitter, grouped by their blocks
+            for(int to : splitter)
             {
-                accept_states_.insert(closure.second);
-                break;
+                for(int from : inverse[c][to])
+                {
+                    int b = block_of[from];
+                    if(marked_of[b].empty())
+                    {
+                        touched_blocks.push_back(b);
+                    }
+                    marked_of[b].push_back(from);
+                    marked[from] = true;
+                }
             }
+
+            // split every block that is partially marked
+            for(int b : touched_blocks)
+            {
+                if(marked_of[b].size() < blocks[b].size())
+                {
+                    int new_block = blocks.size();
+                    std::vector<int> rest;
+                    for(int state : blocks[b])
+                    {
+                        if(! marked[state])
+                        {
+                            rest.push_back(state);
+                        }
+                    }
+                    for(int state : marked_of[b])
+                    {
+                        block_of[state] = new_block;
+                    }
+
+                    blocks[b].swap(rest);
+                    blocks.push_back(marked_of[b]);
+                    in_worklist.push_back(false);
+                    marked_of.emplace_back();
+
+                    // keep both halves if `b` is pending, otherwise the smaller half is enough
+                    if(in_worklist[b] || blocks[new_block].size() <= blocks[b].size())
+                    {
+                        worklist.push_back(new_block);
+                        in_worklist[new_block] = true;
+                    }
+                    else
+                    {
+                        worklist.push_back(b);
+                        in_worklist[b] = true;
+                    }
+                }
+
+                for(int state : marked_of[b])
+                {
+                    marked[state] = false;
+                }
+                marked_of[b].clear();
+            }
+            touched_blocks.clear();
         }
     }
-    
-    
-    start_state_ = dfa_map.at(nfa_p->lambda_closure(nfa_p->start_state()));
 
+    // number the blocks in the order of their first state, the block of the dead state
+    // is dropped unless the start state belongs to it (i.e., nothing is accepted)
+    const int dead_block = block_of[dead];
+    const int start_block = block_of[start_state_];
+    std::vector<int> block_id(blocks.size(), -1);
+    std::vector<int> representative;
+    for(int state = 0; state < dead; state++)
+    {
+        int b = block_of[state];
+        if(block_id[b] == -1 && (b != dead_block || b == start_block))
+        {
+            block_id[b] = representative.size();
+            representative.push_back(state);
+        }
+    }
+
+    std::map<int, std::unordered_map<int, int>> min_transitions;
+    StateSet min_accept_states;
+    std::map<int, int> min_accept_tags;
+    for(int id = 0; id < (int) representative.size(); id++)
+    {
+        const auto row = transitions_.find(representative[id]);
+        if(row != transitions_.end())
+        {
+            for(const auto & kv : row->second)
+            {
+                int to = block_id[block_of[kv.second]];
+                if(to != -1 && block_of[kv.second] != dead_block)
+                {
+                    min_transitions[id][kv.first] = to;
+                }
+            }
+        }
+
+        if(accept_states_.count(representative[id]))
+        {
+            min_accept_states.insert(id);
+            min_accept_tags[id] = accept_tags_.at(representative[id]);
+        }
+    }
+
+    num_states_ = representative.size();
+    start_state_ = block_id[start_block];
+    accept_states_.swap(min_accept_states);
+    accept_tags_.swap(min_accept_tags);
+    transitions_.swap(min_transitions);
+}
+
+/// @brief lay the transition map out as a dense table, one row of `num_classes_` per state
+void DFA::compile_table_()
+{
+    table_.assign(static_cast<size_t>(num_states_) * num_classes_, DEAD_STATE);
+    accept_map_.assign(num_states_, 0);
+    accept_tag_map_.assign(num_states_, NFA::NO_TAG);
+
+    for(const auto & row : transitions_)
+    {
+        int32_t * dst = table_.data() + static_cast<size_t>(row.first) * num_classes_;
+        for(const auto & kv : row.second)
+        {
+            dst[kv.first] = kv.second;
+        }
+    }
+
+    for(int state : accept_states_)
+    {
+        accept_map_[state] = 1;
+    }
+
+    for(const auto & kv : accept_tags_)
+    {
+        accept_tag_map_[kv.first] = kv.second;
+    }
+
+    use_owned_tables_();
+}
+
+void DFA::use_owned_tables_()
+{
+    loaded_ = false;
+    byte_class_p = byte_class_.data();
+    table_p = table_.empty() ? nullptr : table_.data();
+    accept_map_p = accept_map_.data();
+    accept_tag_map_p = accept_tag_map_.data();
+}
+
+namespace
+{
+
+/// @brief the header of a saved dfa, followed by the byte classes (uint8_t[256]), the table
+///        (int32_t[num_states * num_classes]), the accept flags (uint8_t[num_states], padded
+///        to 4 bytes) and the accept tags (int32_t[num_states])
+struct SavedDFAHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t checksum;
+    int32_t num_states;
+    int32_t num_classes;
+    int32_t start_state;
+    int32_t reserved;
+};
+
+constexpr char SAVED_DFA_MAGIC[8] = "DRCCDFA";
+constexpr uint32_t SAVED_DFA_BYTE_ORDER = 0x01020304;
+
+/// @brief the sizes of the sections following the header
+void saved_dfa_layout(size_t num_states, size_t num_classes, size_t & table_offset,
+    size_t & accept_offset, size_t & tag_offset, size_t & total)
+{
+    table_offset = sizeof(SavedDFAHeader) + DFA::ALPHABET_SIZE;
+    accept_offset = table_offset + num_states * num_classes * sizeof(int32_t);
+    tag_offset = accept_offset + (num_states + 3) / 4 * 4;
+    total = tag_offset + num_states * sizeof(int32_t);
+}
+
+}
+
+void DFA::save(std::ostream & os, uint64_t checksum) const
+{
+    SavedDFAHeader header = {};
+    std::memcpy(header.magic, SAVED_DFA_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.byte_order = SAVED_DFA_BYTE_ORDER;
+    header.checksum = checksum;
+    header.num_states = num_states_;
+    header.num_classes = num_classes_;
+    header.start_state = start_state_;
+
+    size_t table_offset, accept_offset, tag_offset, total;
+    saved_dfa_layout(num_states_, num_classes_, table_offset, accept_offset, tag_offset, total);
+
+    const char padding[4] = {};
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char *>(byte_class_p), ALPHABET_SIZE);
+    os.write(reinterpret_cast<const char *>(table_p), accept_offset - table_offset);
+    os.write(reinterpret_cast<const char *>(accept_map_p), num_states_);
+    os.write(padding, tag_offset - accept_offset - num_states_);
+    os.write(reinterpret_cast<const char *>(accept_tag_map_p), total - tag_offset);
+}
+
+/// @brief the buffer may come from anywhere, so every entry is checked before it is used
+bool DFA::load(const void * data, size_t size, uint64_t checksum, int num_tags)
+{
+    const char * bytes = static_cast<const char *>(data);
+    if(size < sizeof(SavedDFAHeader) || reinterpret_cast<uintptr_t>(data) % alignof(SavedDFAHeader) != 0)
+    {
+        return false;
+    }
+
+    const SavedDFAHeader & header = *reinterpret_cast<const SavedDFAHeader *>(bytes);
+    if(std::memcmp(header.magic, SAVED_DFA_MAGIC, sizeof(header.magic)) != 0
+        || header.version != FORMAT_VERSION || header.byte_order != SAVED_DFA_BYTE_ORDER
+        || header.checksum != checksum)
+    {
+        return false;
+    }
+
+    const int32_t num_states = header.num_states, num_classes = header.num_classes;
+    if(num_states <= 0 || num_classes <= 0 || num_classes > ALPHABET_SIZE
+        || header.start_state < 0 || header.start_state >= num_states)
+    {
+        return false;
+    }
+
+    size_t table_offset, accept_offset, tag_offset, total;
+    saved_dfa_layout(num_states, num_classes, table_offset, accept_offset, tag_offset, total);
+    if(size != total)
+    {
+        return false;
+    }
+
+    const uint8_t * byte_class = reinterpret_cast<const uint8_t *>(bytes + sizeof(SavedDFAHeader));
+    const int32_t * table = reinterpret_cast<const int32_t *>(bytes + table_offset);
+    const uint8_t * accept = reinterpret_cast<const uint8_t *>(bytes + accept_offset);
+    const int32_t * accept_tag = reinterpret_cast<const int32_t *>(bytes + tag_offset);
+
+    for(int ch = 0; ch < ALPHABET_SIZE; ch++)
+    {
+        if(byte_class[ch] >= num_classes)
+        {
+            return false;
+        }
+    }
+
+    for(size_t i = 0; i < static_cast<size_t>(num_states) * num_classes; i++)
+    {
+        if(table[i] < DEAD_STATE || table[i] >= num_states)
+        {
+            return false;
+        }
+    }
+
+    for(int state = 0; state < num_states; state++)
+    {
+        if(accept[state] > 1 || (accept[state] && (accept_tag[state] < 0 || accept_tag[state] >= num_tags)))
+        {
+            return false;
+        }
+    }
+
+    // the construction form is not kept: the dfa is only used for matching
+    num_states_ = num_raw_states_ = num_states;
+    num_classes_ = num_classes;
+    start_state_ = header.start_state;
+    accept_states_.clear();
+    accept_tags_.clear();
+    transitions_.clear();
+    table_.clear();
+    accept_map_.clear();
+    accept_tag_map_.clear();
+
+    byte_class_p = byte_class;
+    table_p = table;
+    accept_map_p = accept;
+    accept_tag_map_p = accept_tag;
+    loaded_ = true;
+
+    return true;
 }
 
 int DFA::max_accept_length(const char * const s, int max_length) const
 {
+    // not built (or empty): nothing can be matched
+    if(table_p == nullptr)
+    {
+        return 0;
+    }
+
+    const int32_t * table = table_p;
+    const uint8_t * byte_class = byte_class_p;
+    const uint8_t * accept = accept_map_p;
+    const size_t num_classes = num_classes_;
+
     int max_ans = 0;
-    int now_state = this->start_state_;
+    int32_t now_state = this->start_state_;
     for(int i = 0; i < max_length; i++)
     {
-        char ch = s[i];
+        // transfer through the compiled table
+        now_state = table[now_state * num_classes + byte_class[static_cast<unsigned char>(s[i])]];
 
         // no corresponding stransition: the matching fails
-        if(transitions_.count(now_state) == 0 || transitions_.at(now_state).count(ch) == 0)
+        if(now_state == DEAD_STATE)
         {
             break;
         }
-
-        // transfer through existing rules
-        now_state = transitions_.at(now_state).at(ch);
         
         // update the answer if the current state is accepted
-        if(accept_states_.count(now_state) != 0)
+        if(accept[now_state])
         {
-            max_ans= i + 1;
+            max_ans = i + 1;
         }
     }
 
     return max_ans;
 }
 
+int DFA::max_accept_length(const char * const s, int max_length, int & tag) const
+{
+    bool truncated = false;
+    return max_accept_length(s, max_length, tag, truncated);
+}
+
+int DFA::max_accept_length(const char * const s, int max_length, int & tag, bool & truncated) const
+{
+    truncated = false;
+    if(table_p == nullptr)
+    {
+        return 0;
+    }
+
+    const int32_t * table = table_p;
+    const uint8_t * byte_class = byte_class_p;
+    const uint8_t * accept = accept_map_p;
+    const size_t num_classes = num_classes_;
+
+    int max_ans = 0;
+    int32_t now_state = this->start_state_;
+    int32_t accepted_state = DEAD_STATE;
+    int i = 0;
+    for(; i < max_length; i++)
+    {
+        now_state = table[now_state * num_classes + byte_class[static_cast<unsigned char>(s[i])]];
+
+        if(now_state == DEAD_STATE)
+        {
+            break;
+        }
+        
+        // remember where the longest match ends, the tag is looked up once
+        if(accept[now_state])
+        {
+            max_ans = i + 1;
+            accepted_state = now_state;
+        }
+    }
+
+    if(accepted_state != DEAD_STATE)
+    {
+        tag = accept_tag_map_p[accepted_state];
+    }
+
+    truncated = i == max_length;
+    return max_ans;
+}
+
 // deep copy (see fsm.h)
 DFA & DFA::operator= (const DFA & src)
 {
@@ -142,10 +782,68 @@ DFA & DFA::operator= (const DFA & src)
     nfa_p = src.nfa_p;
     nfa_used_ = src.nfa_used_;
     from_nfa_ = src.from_nfa_;
+    minimize_enabled_ = src.minimize_enabled_;
     num_states_ = src.num_states_;
+    num_raw_states_ = src.num_raw_states_;
     start_state_ = src.start_state_;
     accept_states_ = src.accept_states_;
+    accept_tags_ = src.accept_tags_;
+    num_classes_ = src.num_classes_;
+    byte_class_ = src.byte_class_;
     transitions_ = src.transitions_;
+    table_ = src.table_;
+    accept_map_ = src.accept_map_;
+    accept_tag_map_ = src.accept_tag_map_;
+
+    if(src.loaded_)
+    {
+        byte_class_p = src.byte_class_p;
+        table_p = src.table_p;
+        accept_map_p = src.accept_map_p;
+        accept_tag_map_p = src.accept_tag_map_p;
+        loaded_ = true;
+    }
+    else
+    {
+        use_owned_tables_();
+    }
+
+    return *this;
+}
+
+// move (see fsm.h), the moved vectors keep their buffers so loaded and owned tables alike
+// stay valid
+DFA & DFA::operator= (DFA && src)
+{
+    if(this == &src)
+    {
+        return *this;
+    }
+
+    nfa_p = src.nfa_p;
+    nfa_used_ = src.nfa_used_;
+    from_nfa_ = src.from_nfa_;
+    minimize_enabled_ = src.minimize_enabled_;
+    num_states_ = src.num_states_;
+    num_raw_states_ = src.num_raw_states_;
+    start_state_ = src.start_state_;
+    accept_states_ = std::move(src.accept_states_);
+    accept_tags_ = std::move(src.accept_tags_);
+    num_classes_ = src.num_classes_;
+    byte_class_ = std::move(src.byte_class_);
+    transitions_ = std::move(src.transitions_);
+    table_ = std::move(src.table_);
+    accept_map_ = std::move(src.accept_map_);
+    accept_tag_map_ = std::move(src.accept_tag_map_);
+
+    byte_class_p = src.byte_class_p;
+    table_p = src.table_p;
+    accept_map_p = src.accept_map_p;
+    accept_tag_map_p = src.accept_tag_map_p;
+    loaded_ = src.loaded_;
+
+    src.table_p = nullptr;
+    src.loaded_ = false;
 
     return *this;
 }
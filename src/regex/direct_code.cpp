@@ -0,0 +1,94 @@
+#include "regex/regex.h"
+
+#include <map>
+
+namespace Regex
+{
+
+// Each dfa state becomes a label: an accept state records the match, then the next byte is
+// classified and a `switch` jumps to the next label. Classes without a transition fall to
+// `done`, running out of input in a state with transitions marks the match truncated. Only
+// the byte class table is data, the transitions are code.
+void RegexSet::emit_direct_matcher(std::ostream & os, const std::string & function_name) const
+{
+    const FSM::DFA & dfa = dfa_;
+    const int num_states = compiled_ ? dfa.size() : 0;
+
+    os << "int " << function_name << "(const char * const str, int length, int & tag, bool & truncated)\n";
+    os << "{\n";
+    os << "    truncated = false;\n";
+
+    if(num_states == 0)
+    {
+        os << "    (void) str;\n    (void) length;\n    (void) tag;\n    return 0;\n}\n";
+        return ;
+    }
+
+    os << "    static const unsigned char byte_class[256] = {";
+    for(int ch = 0; ch < FSM::DFA::ALPHABET_SIZE; ch++)
+    {
+        os << (ch % 16 == 0 ? "\n        " : " ") << dfa.byte_class(ch) << ",";
+    }
+    os << "\n    };\n\n";
+
+    os << "    int pos = 0;\n";
+    os << "    int max_length = 0;\n";
+    os << "    int last_tag = 0;\n";
+    os << "    goto state_" << dfa.start_state() << ";\n\n";
+
+    for(int state = 0; state < num_states; state++)
+    {
+        os << "state_" << state << ":\n";
+        if(dfa.is_accept_state(state))
+        {
+            os << "    max_length = pos;\n";
+            os << "    last_tag = " << tags_[dfa.accept_tag(state)] << ";\n";
+        }
+
+        // the classes leading to each state
+        std::map<int32_t, std::vector<int>> targets;
+        for(int c = 0; c < dfa.num_byte_classes(); c++)
+        {
+            int32_t next = dfa.next_state(state, c);
+            if(next != FSM::DFA::DEAD_STATE)
+            {
+                targets[next].push_back(c);
+            }
+        }
+
+        if(targets.empty())
+        {
+            os << "    goto done;\n\n";
+            continue;
+        }
+
+        os << "    if(pos >= length)\n";
+        os << "    {\n";
+        os << "        truncated = true;\n";
+        os << "        goto done;\n";
+        os << "    }\n";
+        os << "    switch(byte_class[static_cast<unsigned char>(str[pos++])])\n";
+        os << "    {\n";
+        for(const auto & kv : targets)
+        {
+            os << "    ";
+            for(int c : kv.second)
+            {
+                os << "case " << c << ": ";
+            }
+            os << "goto state_" << kv.first << ";\n";
+        }
+        os << "    default: goto done;\n";
+        os << "    }\n\n";
+    }
+
+    os << "done:\n";
+    os << "    if(max_length > 0)\n";
+    os << "    {\n";
+    os << "        tag = last_tag;\n";
+    os << "    }\n";
+    os << "    return max_length;\n";
+    os << "}\n";
+}
+
+}
@@ -0,0 +1,285 @@
+#include "regex/fsm.h"
+
+#include <algorithm>
+
+namespace FSM
+{
+
+LazyDFA::LazyDFA(const NFA &nfa, size_t cache_budget)
+    : nfa_p(&nfa), cache_budget_(cache_budget), num_classes_(1),
+    byte_class_(DFA::ALPHABET_SIZE, 0), class_repr_(1, 0),
+    start_state_(DFA::DEAD_STATE), cache_bytes_(0), num_flushes_(0)
+{
+
+}
+
+void LazyDFA::build()
+{
+    num_classes_ = nfa_p->byte_classes(byte_class_);
+
+    // the smallest byte of each class stands for the whole class
+    class_repr_.assign(num_classes_, 0);
+    for(int ch = DFA::ALPHABET_SIZE - 1; ch >= 0; ch--)
+    {
+        class_repr_[byte_class_[ch]] = ch;
+    }
+
+    mark_.assign(nfa_p->size(), 0);
+    num_flushes_ = 0;
+    flush_();
+}
+
+void LazyDFA::set_cache_budget(size_t cache_budget)
+{
+    cache_budget_ = cache_budget;
+    if(start_state_ != DFA::DEAD_STATE)
+    {
+        flush_();
+    }
+}
+
+size_t LazyDFA::cache_budget() const
+{
+    return cache_budget_;
+}
+
+int LazyDFA::size() const
+{
+    return closures_.size();
+}
+
+int LazyDFA::num_flushes() const
+{
+    return num_flushes_;
+}
+
+size_t LazyDFA::ClosureHash::operator()(const std::vector<int> & closure) const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(int state : closure)
+    {
+        hash = (hash ^ static_cast<uint32_t>(state)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+void LazyDFA::flush_() const
+{
+    closures_.clear();
+    closure_idx_.clear();
+    table_.clear();
+    accept_map_.clear();
+    accept_tag_map_.clear();
+    cache_bytes_ = 0;
+
+    // the start state is always cached
+    std::vector<int> start;
+    nfa_p->lambda_closure(nfa_p->start_state(), start);
+    start_state_ = DFA::DEAD_STATE;
+    start_state_ = intern_(start);
+}
+
+int LazyDFA::closure_tag_(const std::vector<int> & closure) const
+{
+    int tag = NFA::NO_TAG;
+    for(int state : closure)
+    {
+        int state_tag = nfa_p->accept_tag(state);
+        if(state_tag != NFA::NO_TAG && (tag == NFA::NO_TAG || state_tag < tag))
+        {
+            tag = state_tag;
+        }
+    }
+    return tag;
+}
+
+int32_t LazyDFA::intern_(const std::vector<int> & closure) const
+{
+    auto iter = closure_idx_.find(closure);
+    if(iter != closure_idx_.end())
+    {
+        return iter->second;
+    }
+
+    // a row of the table, the closure itself and its hash table entry
+    size_t cost = num_classes_ * sizeof(int32_t) + 2 * closure.size() * sizeof(int) + 64;
+    if(start_state_ != DFA::DEAD_STATE && cache_bytes_ + cost > cache_budget_)
+    {
+        return DFA::DEAD_STATE;
+    }
+
+    int32_t id = closures_.size();
+    closures_.push_back(closure);
+    closure_idx_.emplace(closure, id);
+    table_.resize(table_.size() + num_classes_, UNKNOWN_STATE);
+
+    bool accepted = false;
+    for(int state : closure)
+    {
+        if(nfa_p->is_accept_state(state))
+        {
+            accepted = true;
+            break;
+        }
+    }
+    accept_map_.push_back(accepted);
+    accept_tag_map_.push_back(accepted ? closure_tag_(closure) : NFA::NO_TAG);
+
+    cache_bytes_ += cost;
+    return id;
+}
+
+void LazyDFA::step_(const std::vector<int> & closure, int c, std::vector<int> & next) const
+{
+    const char ch = class_repr_[c];
+    next.clear();
+
+    // the class of byte 0 has no transitions, '\0' marks the lambda moves
+    if(ch == '\0')
+    {
+        return ;
+    }
+
+    for(int state : closure)
+    {
+        const auto & transitions = nfa_p->transitions(state);
+        const auto partial = transitions.find(ch);
+        if(partial == transitions.end())
+        {
+            continue;
+        }
+
+        for(int to : partial->second)
+        {
+            nfa_p->lambda_closure(to, to_closure_);
+            for(int s : to_closure_)
+            {
+                if(! mark_[s])
+                {
+                    mark_[s] = 1;
+                    next.push_back(s);
+                }
+            }
+        }
+    }
+
+    for(int s : next)
+    {
+        mark_[s] = 0;
+    }
+    std::sort(next.begin(), next.end());
+}
+
+int LazyDFA::max_accept_length(const char * const s, int max_length) const
+{
+    int tag = NFA::NO_TAG;
+    return max_accept_length(s, max_length, tag);
+}
+
+int LazyDFA::max_accept_length(const char * const s, int max_length, int & tag) const
+{
+    // not built: nothing can be matched
+    if(start_state_ == DFA::DEAD_STATE)
+    {
+        return 0;
+    }
+
+    int max_ans = 0;
+    int flushes = 0;
+    int32_t now_state = start_state_;
+    std::vector<int> next;
+
+    for(int i = 0; i < max_length; i++)
+    {
+        int c = byte_class_[static_cast<unsigned char>(s[i])];
+        int32_t next_state = table_[static_cast<size_t>(now_state) * num_classes_ + c];
+
+        // explore the transition and remember it
+        if(next_state == UNKNOWN_STATE)
+        {
+            step_(closures_[now_state], c, next);
+            if(next.empty())
+            {
+                next_state = DFA::DEAD_STATE;
+            }
+            else if((next_state = intern_(next)) == DFA::DEAD_STATE)
+            {
+                // the cache is full: start over with an empty cache, or give up caching
+                // if this match keeps flushing it
+                num_flushes_++;
+                if(++flushes > MAX_FLUSHES_PER_MATCH)
+                {
+                    return simulate_nfa_(next, s, i + 1, max_length, max_ans, tag);
+                }
+
+                flush_();
+                next_state = intern_(next);
+                if(next_state == DFA::DEAD_STATE)
+                {
+                    return simulate_nfa_(next, s, i + 1, max_length, max_ans, tag);
+                }
+
+                now_state = next_state;
+                if(accept_map_[now_state])
+                {
+                    max_ans = i + 1;
+                    tag = accept_tag_map_[now_state];
+                }
+                continue;
+            }
+
+            table_[static_cast<size_t>(now_state) * num_classes_ + c] = next_state;
+        }
+
+        // no corresponding stransition: the matching fails
+        if(next_state == DFA::DEAD_STATE)
+        {
+            break;
+        }
+
+        now_state = next_state;
+        if(accept_map_[now_state])
+        {
+            max_ans = i + 1;
+            tag = accept_tag_map_[now_state];
+        }
+    }
+
+    return max_ans;
+}
+
+int LazyDFA::simulate_nfa_(std::vector<int> closure, const char * const s, int pos, int max_length,
+    int max_ans, int & tag) const
+{
+    std::vector<int> next;
+
+    // the closure after `pos` bytes is not checked by the caller yet
+    for(int i = pos; ; i++)
+    {
+        for(int state : closure)
+        {
+            if(nfa_p->is_accept_state(state))
+            {
+                max_ans = i;
+                tag = closure_tag_(closure);
+                break;
+            }
+        }
+
+        if(i >= max_length)
+        {
+            break;
+        }
+
+        step_(closure, byte_class_[static_cast<unsigned char>(s[i])], next);
+        if(next.empty())
+        {
+            break;
+        }
+        closure.swap(next);
+    }
+
+    return max_ans;
+}
+
+}
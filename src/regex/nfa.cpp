@@ -1,5 +1,6 @@
 #include "regex/fsm.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace FSM
@@ -7,12 +8,79 @@ namespace FSM
 
 NFA::NFA(int num_states, int start_state)
     : num_states_(num_states), lambda_closure_generated_(false),
-    transitions_(num_states), lambda_closure_(num_states),
+    transitions_(num_states), component_(num_states, NO_COMPONENT), components_(),
     start_state_(start_state), accept_states_()
 {
 
 }
 
+int NFA::add_state()
+{
+    transitions_.emplace_back();
+    component_.push_back(NO_COMPONENT);
+    return num_states_++;
+}
+
+// grow geometrically, so that appending to an nfa over and over stays linear
+void NFA::reserve(int num_states)
+{
+    if(static_cast<size_t>(num_states) > transitions_.capacity())
+    {
+        num_states = std::max<size_t>(num_states, 2 * transitions_.capacity());
+        transitions_.reserve(num_states);
+        component_.reserve(num_states);
+    }
+}
+
+int NFA::append(const NFA & src, bool keep_closures)
+{
+    keep_closures = keep_closures && src.lambda_closure_generated_;
+    const int offset = num_states_;
+    reserve(num_states_ + src.num_states_);
+    for(int state = 0; state < src.num_states_; state++)
+    {
+        add_state();
+    }
+
+    for(int state = 0; state < src.num_states_; state++)
+    {
+        for(const auto & kv : src.transitions_[state])
+        {
+            for(int to : kv.second)
+            {
+                transitions_[state + offset][kv.first].insert(to + offset);
+            }
+        }
+
+        // the closures of `src` stay valid, its states only reach each other
+        if(keep_closures && src.component_[state] != NO_COMPONENT)
+        {
+            component_[state + offset] = src.component_[state] + components_.size();
+        }
+    }
+
+    if(keep_closures)
+    {
+        const int first = components_.size();
+        components_.reserve(first + src.components_.size());
+        for(const LambdaComponent & src_component : src.components_)
+        {
+            components_.push_back(src_component);
+            for(int & to : components_.back().states)
+            {
+                to += offset;
+            }
+            for(int & link : components_.back().links)
+            {
+                link += first;
+            }
+        }
+    }
+
+    lambda_closure_generated_ = lambda_closure_generated_ && keep_closures;
+    return offset;
+}
+
 void NFA::add_transition(int from, char ch, int to)
 {
     transitions_[from][ch].insert(to);
@@ -24,9 +92,16 @@ void NFA::add_transitions(int from, char ch, const StateSet & dsts)
     transitions_[from][ch].insert(dsts.begin(), dsts.end());
 }
 
-void NFA::add_accept_state(int state)
+void NFA::add_accept_state(int state, int tag)
 {
     accept_states_.insert(state);
+
+    // keep the smallest tag if the state is tagged several times
+    auto iter = accept_tags_.find(state);
+    if(iter == accept_tags_.end() || tag < iter->second)
+    {
+        accept_tags_[state] = tag;
+    }
 }
 
 void NFA::remove_accept_state(int state)
@@ -34,12 +109,50 @@ void NFA::remove_accept_state(int state)
     if(accept_states_.count(state) != 0)
     {
         accept_states_.erase(state);
+        accept_tags_.erase(state);
     }
 }
 
-const StateSet & NFA::lambda_closure(int state) const
+int NFA::accept_tag(int state) const
 {
-    return lambda_closure_[state];
+    auto iter = accept_tags_.find(state);
+    return iter == accept_tags_.end() ? NO_TAG : iter->second;
+}
+
+void NFA::lambda_closure(int state, std::vector<int> & closure) const
+{
+    closure.clear();
+    if(component_[state] == NO_COMPONENT)
+    {
+        return;
+    }
+
+    const LambdaComponent & component = components_[component_[state]];
+    if(component.links.empty())
+    {
+        closure.assign(component.states.begin(), component.states.end());
+        return;
+    }
+
+    // gather the components reached, each once: the stored closures may overlap
+    std::vector<int> pending(1, component_[state]);
+    std::unordered_set<int> entered(pending.begin(), pending.end());
+    while(! pending.empty())
+    {
+        const LambdaComponent & now = components_[pending.back()];
+        pending.pop_back();
+
+        closure.insert(closure.end(), now.states.begin(), now.states.end());
+        for(int link : now.links)
+        {
+            if(entered.insert(link).second)
+            {
+                pending.push_back(link);
+            }
+        }
+    }
+    std::sort(closure.begin(), closure.end());
+    closure.erase(std::unique(closure.begin(), closure.end()), closure.end());
 }
 
 const std::unordered_map<char, StateSet> & NFA::transitions(int state) const 
@@ -72,45 +185,208 @@ int NFA::size() const
     return num_states_;
 }
 
+// Tarjan's algorithm over the lambda moves, without recursion. A strongly connected component
+// is completed after all the components it reaches, so its closure is its members together
+// with the closures of the components it moves to, and all its members share it. A small
+// closure is stored whole, a larger one as links to those components, so that no closure is
+// copied into another. States whose closure is already known (e.g., copied by `append`) are
+// not entered again.
 void NFA::build()
 {
-    // calculate the lambda closure of each state
-    for(int i = 0; i < num_states_; i++)
+    std::vector<int> index(num_states_, -1), low(num_states_, 0);
+    std::vector<uint8_t> on_stack(num_states_, 0);
+    std::vector<int> component;
+    std::vector<int> members;
+
+    // the dfs path: a state and how many of its lambda moves are explored
+    std::vector<std::pair<int, size_t>> path;
+    std::vector<std::vector<int>> moves(num_states_);
+    int counter = 0;
+
+    // the lambda moves of a state, in a stable order
+    auto lambda_moves = [this](int state) {
+        std::vector<int> ans;
+        const auto iter = transitions_[state].find('\0');
+        if(iter != transitions_[state].end())
+        {
+            ans.assign(iter->second.begin(), iter->second.end());
+        }
+        return ans;
+    };
+
+    // the closure of a finished component
+    std::vector<int> seen_component(components_.size(), -1);
+    auto close_component = [&]() {
+        const int idx = components_.size();
+        seen_component.resize(idx + 1, -1);
+
+        LambdaComponent closed;
+        closed.states.assign(members.begin(), members.end());
+        closed.size_bound = std::min(members.size(), MAX_EXPANDED_CLOSURE + 1);
+        closed.accepting = false;
+        for(int state : members)
+        {
+            closed.accepting = closed.accepting || accept_states_.count(state) != 0;
+            for(int to : moves[state])
+            {
+                // each component is linked once
+                const int to_idx = component_[to];
+                if(to_idx == NO_COMPONENT || to_idx == idx || seen_component[to_idx] == idx)
+                {
+                    continue;
+                }
+                seen_component[to_idx] = idx;
+
+                closed.links.push_back(to_idx);
+                // saturated, the bound only tells whether the closure is stored whole
+                closed.size_bound = std::min(closed.size_bound + components_[to_idx].size_bound,
+                    MAX_EXPANDED_CLOSURE + 1);
+                closed.accepting = closed.accepting || components_[to_idx].accepting;
+            }
+            std::vector<int>().swap(moves[state]);
+        }
+
+        // the components linked are stored whole too, as their closures are smaller
+        if(closed.size_bound <= MAX_EXPANDED_CLOSURE)
+        {
+            for(int link : closed.links)
+            {
+                const std::vector<int> & states = components_[link].states;
+                closed.states.insert(closed.states.end(), states.begin(), states.end());
+            }
+            closed.links.clear();
+        }
+        std::sort(closed.states.begin(), closed.states.end());
+        closed.states.erase(std::unique(closed.states.begin(), closed.states.end()), closed.states.end());
+
+        // the members reach an accept state via '\0'
+        if(closed.accepting)
+        {
+            accept_states_.insert(members.begin(), members.end());
+        }
+        components_.push_back(std::move(closed));
+    };
+
+    for(int root = 0; root < num_states_; root++)
     {
-        if(lambda_closure_[i].size() == 0)
+        if(component_[root] != NO_COMPONENT || index[root] != -1)
         {
-            compute_lambda_closure(i);
+            continue;
+        }
+
+        index[root] = low[root] = counter++;
+        component.push_back(root);
+        on_stack[root] = 1;
+        moves[root] = lambda_moves(root);
+        path.emplace_back(root, 0);
+
+        while(! path.empty())
+        {
+            const int state = path.back().first;
+            size_t & explored = path.back().second;
+
+            if(explored < moves[state].size())
+            {
+                const int next_state = moves[state][explored++];
+                if(component_[next_state] != NO_COMPONENT)
+                {
+                    continue;
+                }
+
+                if(index[next_state] == -1)
+                {
+                    index[next_state] = low[next_state] = counter++;
+                    component.push_back(next_state);
+                    on_stack[next_state] = 1;
+                    moves[next_state] = lambda_moves(next_state);
+                    path.emplace_back(next_state, 0);
+                }
+                else if(on_stack[next_state])
+                {
+                    low[state] = std::min(low[state], index[next_state]);
+                }
+                continue;
+            }
+
+            // all moves explored: close the component if the state is its root
+            path.pop_back();
+            if(! path.empty())
+            {
+                low[path.back().first] = std::min(low[path.back().first], low[state]);
+            }
+
+            if(low[state] != index[state])
+            {
+                continue;
+            }
+
+            members.clear();
+            int member;
+            do
+            {
+                member = component.back();
+                component.pop_back();
+                on_stack[member] = 0;
+                members.push_back(member);
+                component_[member] = components_.size();
+            } while(member != state);
+
+            close_component();
         }
     }
+
     lambda_closure_generated_ = true;
 }
 
-void NFA::compute_lambda_closure(int state)
+/// @brief Two bytes are equivalent if every state moves to the same set of states on
+///        both. Starting from a single class, each group of bytes sharing a destination set
+///        splits the classes it intersects.
+int NFA::byte_classes(std::vector<uint8_t> & byte_class) const
 {
-    // compute the lambda closure in a DFS manner
-
-    StateSet & closure = lambda_closure_[state];
-    closure.insert(state);
+    std::vector<int> cls(256, 0);
+    int num_ids = 1;
 
-    // the lambda closure of a state contains the union of lambda-closures of all its lambda-neighbors
-    for(int next_state : transitions_[state]['\0'])
+    for(int state = 0; state < num_states_; state++)
     {
-        if(closure.count(next_state) != 0)
+        // group the bytes leaving this state by their destinations
+        std::map<StateSet, std::vector<unsigned char>> groups;
+        for(const auto & kv : transitions_[state])
         {
-            continue;
+            if(kv.first != '\0')
+            {
+                groups[kv.second].push_back(kv.first);
+            }
         }
 
-        // insert before search in order to avoid infinte loop
-        closure.insert(next_state);
-        compute_lambda_closure(next_state);
-        closure.insert(lambda_closure_[next_state].begin(), lambda_closure_[next_state].end());
-        
-        if(is_accept_state(next_state))
+        // move the members of a group to a fresh class, one per class they come from
+        for(const auto & group : groups)
         {
-            accept_states_.insert(state);
+            std::map<int, int> remap;
+            for(unsigned char ch : group.second)
+            {
+                auto iter = remap.find(cls[ch]);
+                if(iter == remap.end())
+                {
+                    iter = remap.emplace(cls[ch], num_ids++).first;
+                }
+                cls[ch] = iter->second;
+            }
         }
+    }
 
+    // compact the class ids in the order of their smallest byte
+    std::map<int, int> compact;
+    byte_class.resize(256);
+    for(int ch = 0; ch < 256; ch++)
+    {
+        auto iter = compact.find(cls[ch]);
+        if(iter == compact.end())
+        {
+            iter = compact.emplace(cls[ch], compact.size()).first;
+        }
+        byte_class[ch] = iter->second;
     }
+    return compact.size();
 }
 
 bool NFA::built() const
@@ -128,10 +404,8 @@ void NFA::degrade()
 
     lambda_closure_generated_ = false;
 
-    for(StateSet & closure : lambda_closure_)
-    {
-        closure.clear();
-    }
+    component_.assign(num_states_, NO_COMPONENT);
+    components_.clear();
 }
 
 
@@ -147,8 +421,10 @@ NFA & NFA::operator= (const NFA & src)
     num_states_ = src.num_states_;
     lambda_closure_generated_ = src.lambda_closure_generated_;
     accept_states_ = src.accept_states_;
+    accept_tags_ = src.accept_tags_;
     transitions_ = src.transitions_;
-    lambda_closure_ = src.lambda_closure_;
+    component_ = src.component_;
+    components_ = src.components_;
 
     return *this;
 }
@@ -0,0 +1,199 @@
+#include "regex/fsm.h"
+
+#include <cstring>
+
+namespace FSM
+{
+
+namespace
+{
+
+/// @brief a rough rank of how often a byte shows up in source code and assembly, higher
+///        is more frequent: blanks, then lower case letters, digits and punctuation
+int byte_frequency(unsigned char ch)
+{
+    static const char common[] = " etaoinsrlcd\n\t";
+    if(ch != '\0' && std::strchr(common, ch) != nullptr)
+    {
+        return 5;
+    }
+    if(ch >= 'a' && ch <= 'z')
+    {
+        return 4;
+    }
+    if((ch >= '0' && ch <= '9') || ch == '_' || ch == '(' || ch == ')' || ch == ',' || ch == ';' || ch == '$')
+    {
+        return 3;
+    }
+    if(ch >= 0x20 && ch < 0x7f)
+    {
+        return 2;
+    }
+    return 1;
+}
+
+/// @brief the states reached from `states` by `ch`, with their lambda closures
+StateSet step(const NFA & nfa, const StateSet & states, char ch)
+{
+    StateSet next;
+    std::vector<int> closure;
+    for(int state : states)
+    {
+        const auto & transitions = nfa.transitions(state);
+        const auto partial = transitions.find(ch);
+        if(partial == transitions.end())
+        {
+            continue;
+        }
+
+        for(int to : partial->second)
+        {
+            nfa.lambda_closure(to, closure);
+            next.insert(closure.begin(), closure.end());
+        }
+    }
+    return next;
+}
+
+}
+
+Prefilter::Prefilter()
+    : prefix_(), rare_index_(0), first_bytes_(DFA::ALPHABET_SIZE, 0), first_byte_list_(),
+    matches_empty_(true)
+{
+
+}
+
+void Prefilter::build(const NFA & nfa)
+{
+    *this = Prefilter();
+
+    std::vector<int> start;
+    nfa.lambda_closure(nfa.start_state(), start);
+    StateSet now(start.begin(), start.end());
+    matches_empty_ = false;
+    for(int state : now)
+    {
+        matches_empty_ = matches_empty_ || nfa.is_accept_state(state);
+    }
+
+    // the bytes leaving the start closure ('\0' marks the lambda moves)
+    for(int state : now)
+    {
+        for(const auto & kv : nfa.transitions(state))
+        {
+            if(kv.first != '\0')
+            {
+                first_bytes_[static_cast<unsigned char>(kv.first)] = 1;
+            }
+        }
+    }
+
+    for(int ch = 1; ch < DFA::ALPHABET_SIZE && first_byte_list_.size() <= 3; ch++)
+    {
+        if(first_bytes_[ch])
+        {
+            first_byte_list_.push_back(static_cast<char>(ch));
+        }
+    }
+
+    // follow the path as long as it has a single byte to go on with and may not end
+    while(! matches_empty_ && prefix_.size() < MAX_PREFIX)
+    {
+        bool accepted = false;
+        std::set<char> bytes;
+        for(int state : now)
+        {
+            accepted = accepted || nfa.is_accept_state(state);
+            for(const auto & kv : nfa.transitions(state))
+            {
+                if(kv.first != '\0')
+                {
+                    bytes.insert(kv.first);
+                }
+            }
+        }
+
+        if(accepted || bytes.size() != 1)
+        {
+            break;
+        }
+
+        prefix_.push_back(*bytes.begin());
+        now = step(nfa, now, *bytes.begin());
+    }
+
+    for(size_t i = 1; i < prefix_.size(); i++)
+    {
+        if(byte_frequency(prefix_[i]) < byte_frequency(prefix_[rare_index_]))
+        {
+            rare_index_ = i;
+        }
+    }
+}
+
+size_t Prefilter::next_candidate(const char * const str, size_t from, size_t length) const
+{
+    if(matches_empty_ || from >= length)
+    {
+        return from < length ? from : length;
+    }
+
+    // the rarest byte of the prefix, then the whole prefix around it
+    if(! prefix_.empty())
+    {
+        const char rare = prefix_[rare_index_];
+        for(size_t pos = from + rare_index_; pos + prefix_.size() - rare_index_ <= length; pos++)
+        {
+            const void * found = std::memchr(str + pos, rare, length - pos);
+            if(found == nullptr)
+            {
+                break;
+            }
+
+            pos = static_cast<const char *>(found) - str;
+            size_t begin = pos - rare_index_;
+            if(begin + prefix_.size() <= length && std::memcmp(str + begin, prefix_.data(), prefix_.size()) == 0)
+            {
+                return begin;
+            }
+        }
+        return length;
+    }
+
+    // a few first bytes: the nearest of them
+    if(first_byte_list_.size() <= 3)
+    {
+        size_t best = length;
+        for(char ch : first_byte_list_)
+        {
+            const void * found = std::memchr(str + from, ch, best - from);
+            if(found != nullptr)
+            {
+                best = static_cast<const char *>(found) - str;
+            }
+        }
+        return best;
+    }
+
+    for(size_t pos = from; pos < length; pos++)
+    {
+        if(first_bytes_[static_cast<unsigned char>(str[pos])])
+        {
+            return pos;
+        }
+    }
+    return length;
+}
+
+bool Prefilter::matches_empty() const
+{
+    return matches_empty_;
+}
+
+const std::string & Prefilter::literal_prefix() const
+{
+    return prefix_;
+}
+
+}
@@ -1,21 +1,40 @@
 #include "regex/regex.h"
 
 #include <unordered_map>
+#include <algorithm>
+#include <sstream>
+#include <cerrno>
 #include <cstring>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace Regex
 {
 
 // initialize by a nfa
 RegexPatObj::RegexPatObj(const FSM::NFA & nfa)
-    : nfa_(nfa), dfa_(nfa_), compiled_(false)
+    : nfa_(nfa), dfa_(nfa_), lazy_dfa_(nfa_),
+    compiled_(false), lazy_(false), bit_parallel_(false)
+{
+
+}
+
+// initialize by a nfa, taking over its states
+RegexPatObj::RegexPatObj(FSM::NFA && nfa)
+    : nfa_(std::move(nfa)), dfa_(nfa_), lazy_dfa_(nfa_),
+    compiled_(false), lazy_(false), bit_parallel_(false)
 {
 
 }
 
 // initialize by a fixed pattern
 RegexPatObj::RegexPatObj(const char *const pattern)
-    : nfa_(std::strlen(pattern) + 1, 0), dfa_(nfa_), compiled_(false)
+    : nfa_(std::strlen(pattern) + 1, 0), dfa_(nfa_), lazy_dfa_(nfa_),
+    compiled_(false), lazy_(false), bit_parallel_(false)
 {
     int length = std::strlen(pattern);
     for(int i = 0; i < length; i++)
@@ -28,7 +47,8 @@ RegexPatObj::RegexPatObj(const char *const pattern)
 
 // initialize by a set of accepting characters
 RegexPatObj::RegexPatObj(const std::set<char> &acc_char_set)
-    : nfa_(2, 0), dfa_(nfa_), compiled_(false)
+    : nfa_(2, 0), dfa_(nfa_), lazy_dfa_(nfa_),
+    compiled_(false), lazy_(false), bit_parallel_(false)
 {
     for(char acc_char : acc_char_set)
     {
@@ -39,7 +59,8 @@ RegexPatObj::RegexPatObj(const std::set<char> &acc_char_set)
 
 // initialize by a contiguous range of accepting characters, e.g., a-z
 RegexPatObj::RegexPatObj(char range_first, char range_last)
-    : nfa_(2, 0), dfa_(nfa_), compiled_(false)
+    : nfa_(2, 0), dfa_(nfa_), lazy_dfa_(nfa_),
+    compiled_(false), lazy_(false), bit_parallel_(false)
 {
     if(range_last < range_first)
     {
@@ -53,93 +74,160 @@ RegexPatObj::RegexPatObj(char range_first, char range_last)
     nfa_.add_accept_state(1);
 }
 
+// copy the automata, the lazy dfa refers to the nfa so it is rebuilt on the copy
+RegexPatObj::RegexPatObj(const RegexPatObj & src)
+    : nfa_(src.nfa_), dfa_(src.dfa_), lazy_dfa_(nfa_, src.lazy_dfa_.cache_budget()),
+    compiled_(src.compiled_), lazy_(src.lazy_), bit_parallel_(src.bit_parallel_), bit_nfa_(src.bit_nfa_),
+    prefilter_(src.prefilter_)
+{
+    if(lazy_)
+    {
+        lazy_dfa_.build();
+    }
+}
+
+// move the automata, the lazy dfa refers to the nfa so it is rebuilt
+RegexPatObj::RegexPatObj(RegexPatObj && src)
+    : nfa_(std::move(src.nfa_)), dfa_(std::move(src.dfa_)), lazy_dfa_(nfa_, src.lazy_dfa_.cache_budget()),
+    compiled_(src.compiled_), lazy_(src.lazy_), bit_parallel_(src.bit_parallel_), bit_nfa_(std::move(src.bit_nfa_)),
+    prefilter_(std::move(src.prefilter_))
+{
+    if(lazy_)
+    {
+        lazy_dfa_.build();
+    }
+    src.compiled_ = false;
+    src.lazy_ = false;
+    src.bit_parallel_ = false;
+}
+
 // the longest accept prefix (call the API of dfa directly)
 int RegexPatObj::max_matched_lenghth(const char *const target_str, int length) const
 {
+    if(lazy_)
+    {
+        return this->lazy_dfa_.max_accept_length(target_str, length);
+    }
+    if(bit_parallel_)
+    {
+        return this->bit_nfa_.max_accept_length(target_str, length);
+    }
     return this->dfa_.max_accept_length(target_str, length);
 }
 
-// the two regular expressions are apearing in sequential order
-RegexPatObj RegexPatObj::operator+(const RegexPatObj &rhs) const
+// the anchored matcher at the candidates of the prefilter, which is built by `compile`
+bool RegexPatObj::find(const char * const target_str, int length, int & match_begin, int & match_length, int from) const
 {
-    FSM::NFA ret_nfa(nfa_.size() + rhs.nfa_.size(), nfa_.start_state());
+    if(! compiled_ || from < 0 || from > length)
+    {
+        return false;
+    }
 
-    // the left regex
-    for(int state = 0; state < nfa_.size(); state++)
+    // every position matches, the first one is the leftmost
+    if(prefilter_.matches_empty())
+    {
+        match_begin = from;
+        match_length = max_matched_lenghth(target_str + from, length - from);
+        return true;
+    }
+
+    for(size_t pos = from; ; pos++)
     {
-        const auto & transition_tab = nfa_.transitions(state);
-        for(const auto &kv : transition_tab)
+        pos = prefilter_.next_candidate(target_str, pos, length);
+        if(pos >= static_cast<size_t>(length))
+        {
+            return false;
+        }
+
+        int matched_len = max_matched_lenghth(target_str + pos, length - pos);
+        if(matched_len > 0)
         {
-            ret_nfa.add_transitions(state, kv.first, kv.second);
+            match_begin = pos;
+            match_length = matched_len;
+            return true;
         }
     }
+}
 
+// an empty match moves the search one byte further
+std::vector<std::pair<int, int>> RegexPatObj::find_all(const char * const target_str, int length) const
+{
+    std::vector<std::pair<int, int>> matches;
+    int match_begin = 0, match_length = 0;
 
-    // place the right regex after the left
-    int left_size = nfa_.size();
+    for(int pos = 0; find(target_str, length, match_begin, match_length, pos); )
+    {
+        matches.emplace_back(match_begin, match_length);
+        pos = match_begin + std::max(match_length, 1);
+    }
+
+    return matches;
+}
+
+// the two regular expressions are apearing in sequential order
+RegexPatObj RegexPatObj::operator+(const RegexPatObj &rhs) const
+{
+    RegexPatObj ret(nfa_);
+    ret += rhs;
+    return ret;
+}
 
-    for(int state_1 = 0; state_1 < rhs.nfa_.size(); state_1++)
+// place the right regex after the left, in place
+RegexPatObj &RegexPatObj::operator+=(const RegexPatObj &rhs)
+{
+    // appending to itself would read the states being added
+    if(this == &rhs)
     {
-        const auto & transition_tab = rhs.nfa_.transitions(state_1);
-        for(const auto &kv : transition_tab)
-        {
-            for(const int &to : kv.second)
-            {
-                ret_nfa.add_transition(state_1 + left_size, kv.first, to + left_size);
-            }
-        }
+        return *this += RegexPatObj(rhs.nfa_);
     }
 
+    int offset = nfa_.append(rhs.nfa_);
 
     // link the two components
-    for(int from : nfa_.accept_states())
+    const FSM::StateSet left_accept_states = nfa_.accept_states();
+    for(int from : left_accept_states)
     {
-        ret_nfa.add_transition(from, '\0', rhs.nfa_.start_state() + left_size);
+        nfa_.add_transition(from, '\0', rhs.nfa_.start_state() + offset);
+        nfa_.remove_accept_state(from);
     }
 
     for(int acc : rhs.nfa_.accept_states())
     {
-        ret_nfa.add_accept_state(acc + left_size);
+        nfa_.add_accept_state(acc + offset);
     }
-    
-    return RegexPatObj(ret_nfa);
+
+    nfa_.degrade();
+    this->compiled_ = false;
+    this->lazy_ = false;
+    this->bit_parallel_ = false;
+
+    return *this;
+}
+
+// the temporary on the left is reused
+RegexPatObj operator+(RegexPatObj &&lhs, const RegexPatObj &rhs)
+{
+    lhs += rhs;
+    return std::move(lhs);
 }
 
 
 // both regexs are acceptable
 RegexPatObj RegexPatObj::operator|(const RegexPatObj &rhs) const
 {
-    FSM::NFA ret_nfa(nfa_.size() + rhs.nfa_.size() + 2, nfa_.size() + rhs.nfa_.size());
-    int start_state = nfa_.size() + rhs.nfa_.size();
-    int final_state = nfa_.size() + rhs.nfa_.size() + 1;
+    FSM::NFA ret_nfa(nfa_);
+    ret_nfa.degrade();
+    int offset = ret_nfa.append(rhs.nfa_);
+    int start_state = ret_nfa.add_state();
+    int final_state = ret_nfa.add_state();
 
-    // left regex
-    for(int state = 0; state < nfa_.size(); state++)
-    {
-        const auto & transition_tab = nfa_.transitions(state);
-        for(const auto &kv : transition_tab)
-        {
-            ret_nfa.add_transitions(state, kv.first, kv.second);
-        }
-    }
-
-    // right regex
-    int left_size = nfa_.size();
-
-    for(int state_1 = 0; state_1 < rhs.nfa_.size(); state_1++)
+    for(int acc : nfa_.accept_states())
     {
-        const auto & transition_tab = rhs.nfa_.transitions(state_1);
-        for(const auto &kv : transition_tab)
-        {
-            for(const int &to : kv.second)
-            {
-                ret_nfa.add_transition(state_1 + left_size, kv.first, to + left_size);
-            }
-        }
+        ret_nfa.remove_accept_state(acc);
     }
 
-
     // link to the start state and accept states
+    ret_nfa.set_start_state(start_state);
     ret_nfa.add_transition(start_state, '\0', nfa_.start_state());
     for(int acc : nfa_.accept_states())
     {
@@ -147,28 +235,27 @@ RegexPatObj RegexPatObj::operator|(const RegexPatObj &rhs) const
     }
 
     // link to the start state and accept states
-    ret_nfa.add_transition(start_state, '\0', rhs.nfa_.start_state() + left_size);
+    ret_nfa.add_transition(start_state, '\0', rhs.nfa_.start_state() + offset);
     for(int acc : rhs.nfa_.accept_states())
     {
-        ret_nfa.add_transition(acc + left_size, '\0', final_state);
+        ret_nfa.add_transition(acc + offset, '\0', final_state);
     }
 
     // set accept state
     ret_nfa.add_accept_state(final_state);
 
-    return RegexPatObj(ret_nfa);
+    return RegexPatObj(std::move(ret_nfa));
 }
 
 // 0th iterations
 RegexPatObj RegexPatObj::operator*(int times) const
 {
-    RegexPatObj ans(""), a = *this;
+    RegexPatObj ans("");
 
-    ///@todo 1. optimize the multiplication by using O(log N) times of additions
-    ///@todo 2. optimize the addition by using inplace-addition
+    // each step copies `*this` once, in place
     for(int i = 0; i < times; i++)
     {
-        ans = ans + a;
+        ans += *this;
     }
 
     return ans;
@@ -186,29 +273,81 @@ RegexPatObj &RegexPatObj::operator=(const RegexPatObj &src)
     this->nfa_ = src.nfa_;
     this->nfa_.degrade();
     this->dfa_ = FSM::DFA(this->nfa_);
+    this->lazy_dfa_ = FSM::LazyDFA(this->nfa_, src.lazy_dfa_.cache_budget());
+    this->compiled_ = false;
+    this->lazy_ = false;
+    this->bit_parallel_ = false;
+
+    return *this;
+}
+
+// move of a regex, recompiled like a copy
+RegexPatObj &RegexPatObj::operator=(RegexPatObj &&src)
+{
+    if(this == &src)
+    {
+        return *this;
+    }
+
+    this->nfa_ = std::move(src.nfa_);
+    this->nfa_.degrade();
+    this->dfa_ = FSM::DFA(this->nfa_);
+    this->lazy_dfa_ = FSM::LazyDFA(this->nfa_, src.lazy_dfa_.cache_budget());
     this->compiled_ = false;
+    this->lazy_ = false;
+    this->bit_parallel_ = false;
+    src.compiled_ = false;
+    src.lazy_ = false;
+    src.bit_parallel_ = false;
 
     return *this;
 }
 
-// compile the nfa to dfa
-void RegexPatObj::compile()
+// compile the nfa to the bit-parallel matcher if it is small enough, to dfa otherwise
+void RegexPatObj::compile(bool minimize)
 {
     
-    if(this->compiled_)
+    if(this->compiled_ && !this->lazy_)
     {
         return ;
     }
 
     nfa_.build();
-    dfa_ = FSM::DFA(nfa_);
-    dfa_.build();
-
+    prefilter_.build(nfa_);
     this->compiled_ = true;
+    this->lazy_ = false;
+
+    // no subset construction needed
+    if(bit_nfa_.build(nfa_))
+    {
+        this->bit_parallel_ = true;
+        return ;
+    }
+
+    dfa_ = FSM::DFA(nfa_, minimize);
+    dfa_.build();
+    this->bit_parallel_ = false;
 
     return ;
 }
 
+// only the closures are computed, dfa states are built while matching
+void RegexPatObj::compile_lazy(size_t cache_budget)
+{
+    if(this->compiled_ && this->lazy_ && lazy_dfa_.cache_budget() == cache_budget)
+    {
+        return ;
+    }
+
+    nfa_.build();
+    prefilter_.build(nfa_);
+    lazy_dfa_ = FSM::LazyDFA(nfa_, cache_budget);
+    lazy_dfa_.build();
+
+    this->compiled_ = true;
+    this->lazy_ = true;
+}
+
 // iteration operation
 RegexPatObj RegexIter(const RegexPatObj &regex, int min_times)
 {
@@ -225,4 +364,233 @@ RegexPatObj RegexIter(const RegexPatObj &regex, int min_times)
     return (regex * min_times) + loop_regex;
 }
 
+
+RegexSet::RegexSet()
+    : compiled_(false), patterns_(), tags_(), nfa_(1, 0), dfa_(nfa_), mapping_()
+{
+
+}
+
+void RegexSet::add(const RegexPatObj & regex, int tag)
+{
+    patterns_.push_back(regex);
+    tags_.push_back(tag);
+    compiled_ = false;
+}
+
+int RegexSet::size() const
+{
+    return patterns_.size();
+}
+
+// union all patterns under a new start state, tag each accept state by its priority,
+// the patterns already built are appended with their closures
+void RegexSet::build_union_nfa_()
+{
+    int num_states = 1;
+    for(const RegexPatObj & regex : patterns_)
+    {
+        num_states += regex.nfa_.size();
+    }
+
+    FSM::NFA nfa(1, 0);
+    nfa.reserve(num_states);
+    for(int idx = 0; idx < (int) patterns_.size(); idx++)
+    {
+        const FSM::NFA & src = patterns_[idx].nfa_;
+        int offset = nfa.append(src, true);
+
+        nfa.add_transition(0, '\0', src.start_state() + offset);
+        for(int acc : src.accept_states())
+        {
+            nfa.add_accept_state(acc + offset, idx);
+        }
+    }
+
+    nfa_ = std::move(nfa);
+}
+
+void RegexSet::compile(bool minimize)
+{
+    if(this->compiled_)
+    {
+        return ;
+    }
+
+    build_union_nfa_();
+    nfa_.build();
+    dfa_ = FSM::DFA(nfa_, minimize);
+    dfa_.build();
+    mapping_.reset();
+
+    this->compiled_ = true;
+}
+
+// FNV-1a over the structure of the nfa (in a canonical order) and everything else the
+// compiled dfa depends on
+uint64_t RegexSet::checksum_(bool minimize) const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto feed = [&hash](int64_t value) {
+        for(int i = 0; i < 8; i++)
+        {
+            hash = (hash ^ ((value >> (8 * i)) & 0xff)) * 1099511628211ULL;
+        }
+    };
+
+    feed(FSM::DFA::FORMAT_VERSION);
+    feed(minimize);
+    feed(nfa_.size());
+    feed(nfa_.start_state());
+
+    std::vector<char> chars;
+    for(int state = 0; state < nfa_.size(); state++)
+    {
+        const auto & transitions = nfa_.transitions(state);
+        chars.clear();
+        for(const auto & kv : transitions)
+        {
+            chars.push_back(kv.first);
+        }
+        std::sort(chars.begin(), chars.end());
+
+        feed(chars.size());
+        for(char ch : chars)
+        {
+            const FSM::StateSet & dsts = transitions.at(ch);
+            feed(ch);
+            feed(dsts.size());
+            for(int to : dsts)
+            {
+                feed(to);
+            }
+        }
+    }
+
+    feed(nfa_.accept_states().size());
+    for(int acc : nfa_.accept_states())
+    {
+        feed(acc);
+        feed(nfa_.accept_tag(acc));
+    }
+
+    feed(tags_.size());
+    for(int tag : tags_)
+    {
+        feed(tag);
+    }
+
+    return hash;
+}
+
+bool RegexSet::compile_cached(const std::string & path, bool minimize)
+{
+    if(path.empty())
+    {
+        compile(minimize);
+        return false;
+    }
+
+    if(this->compiled_)
+    {
+        return mapping_ != nullptr;
+    }
+
+    build_union_nfa_();
+    const uint64_t checksum = checksum_(minimize);
+
+    // map the cache file and use it if it is built from the same patterns, and only
+    // the user could have written it: `load` checks the tables are in range, not that
+    // they are the ones built from the patterns
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd >= 0)
+    {
+        struct stat st;
+        void * data = MAP_FAILED;
+        if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_uid == getuid() \
+            && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0 && st.st_size > 0)
+        {
+            data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+
+        if(data != MAP_FAILED)
+        {
+            size_t size = st.st_size;
+            std::shared_ptr<const void> mapping(data, [size](const void * p) {
+                munmap(const_cast<void *>(p), size);
+            });
+
+            dfa_ = FSM::DFA(nfa_, minimize);
+            if(dfa_.load(data, size, checksum, tags_.size()))
+            {
+                mapping_ = mapping;
+                this->compiled_ = true;
+                return true;
+            }
+        }
+    }
+
+    // rebuild from the union already made for the checksum, then replace the cache file
+    // atomically so concurrent readers never see a partial file
+    nfa_.build();
+    dfa_ = FSM::DFA(nfa_, minimize);
+    dfa_.build();
+    mapping_.reset();
+    this->compiled_ = true;
+
+    // a fresh file only the user can access: mkstemp never opens an existing file or
+    // follows a link planted at the name
+    std::string tmp_path = path + ".XXXXXX";
+    fd = mkstemp(&tmp_path[0]);
+    if(fd >= 0)
+    {
+        std::ostringstream out;
+        dfa_.save(out, checksum);
+        const std::string bytes = out.str();
+
+        size_t written = 0;
+        while(written < bytes.size())
+        {
+            ssize_t n = write(fd, bytes.data() + written, bytes.size() - written);
+            if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if(n <= 0)
+            {
+                break;
+            }
+            written += n;
+        }
+
+        if(close(fd) != 0 || written != bytes.size() \
+            || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+        {
+            unlink(tmp_path.c_str());
+        }
+    }
+
+    return false;
+}
+
+int RegexSet::max_matched_lenghth(const char * const target_str, int length, int & tag) const
+{
+    bool truncated = false;
+    return max_matched_lenghth(target_str, length, tag, truncated);
+}
+
+int RegexSet::max_matched_lenghth(const char * const target_str, int length, int & tag, bool & truncated) const
+{
+    int idx = FSM::NFA::NO_TAG;
+    int matched_len = dfa_.max_accept_length(target_str, length, idx, truncated);
+
+    if(matched_len > 0)
+    {
+        tag = tags_[idx];
+    }
+
+    return matched_len;
+}
+
 }
@@ -1,48 +1,204 @@
 #include <iostream>
+#include <algorithm>
 
+#include <cerrno>
 #include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "scanner.h"
 #include "miscs.h"
+#include "char_scan.h"
+#include "keywords.h"
 
 
 namespace DRCC
 {
 
+#ifdef DRCC_DIRECT_SCANNER
+// generated by `Scanner::generate_direct_scanner`, see the `direct-scanner` make target
+int direct_scan(const char * const str, int length, int & tag, bool & truncated);
+#endif
+
+/// @brief where the compiled token automaton is kept between runs: `$DRCC_TOKEN_CACHE` if
+///        set (an empty value disables the cache), otherwise `drcc/tokens.dfa` in the user's
+///        cache directory (`$XDG_CACHE_HOME`, or `$HOME/.cache`), created private to the user
+/// @note never a shared directory such as /tmp, where another user could plant the file
+static std::string token_cache_path()
+{
+    const char * path = std::getenv("DRCC_TOKEN_CACHE");
+    if(path != nullptr)
+    {
+        return path;
+    }
+
+    std::string cache_dir;
+    const char * xdg_cache = std::getenv("XDG_CACHE_HOME");
+    const char * home = std::getenv("HOME");
+    if(xdg_cache != nullptr && *xdg_cache == '/')
+    {
+        cache_dir = xdg_cache;
+    }
+    else if(home != nullptr && *home == '/')
+    {
+        cache_dir = std::string(home) + "/.cache";
+    }
+    else
+    {
+        return "";
+    }
+
+    // the cache directory itself may not exist yet
+    mkdir(cache_dir.c_str(), 0700);
+    cache_dir += "/drcc";
+    if(mkdir(cache_dir.c_str(), 0700) != 0 && errno != EEXIST)
+    {
+        return "";
+    }
+    return cache_dir + "/tokens.dfa";
+}
+
 void Scanner::add_tokenizer(const char * const pat, TokenType token_type)
 {
-    Regex::RegexPatObj regex(pat);
-    regex.compile();
-    this->regexs.emplace_back(
-        regex, token_type
-    );
+    this->regexs.add(Regex::RegexPatObj(pat), token_type);
 }
 
 void Scanner::add_tokenizer(Regex::RegexPatObj regex, TokenType token_type)
 {
-    regex.compile();
-    this->regexs.emplace_back(
-        regex, token_type
-    );
+    this->regexs.add(regex, token_type);
 }
 
+/// @brief the lexemes of a streamed input, copied into blocks that never move
+class LexemeArena
+{
+public:
+
+    std::string_view store(const char * const str, size_t length)
+    {
+        if(used_ + length > capacity_)
+        {
+            capacity_ = std::max(BLOCK_SIZE, length);
+            blocks_.emplace_back(new char[capacity_]);
+            used_ = 0;
+        }
+
+        char * dest = blocks_.back().get() + used_;
+        std::memcpy(dest, str, length);
+        used_ += length;
+        return std::string_view(dest, length);
+    }
+
+private:
+
+    static constexpr size_t BLOCK_SIZE = 1 << 16;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t used_ = 0;
+    size_t capacity_ = 0;
+};
+
 Scanner::Scanner()
+    : Scanner(std::string())
 {
-    content = "";
-    init();
+
 }
 
 
 Scanner::Scanner(std::istream &is)
-    : content(std::istreambuf_iterator<char>(is), {})
+    : Scanner(std::string(std::istreambuf_iterator<char>(is), {}))
 {
-    init();
+
 }
 
 Scanner::Scanner(const std::string & input)
-    : content(input)
 {
+    auto owned = std::make_shared<const std::string>(input);
+    set_text(owned, owned->data(), owned->size());
+    init();
+}
+
+Scanner::Scanner(std::istream &is, size_t chunk_size)
+    : stream(&is), chunk_size(std::max<size_t>(chunk_size, 1))
+{
+    lexemes = std::make_shared<LexemeArena>();
+    source_text = lexemes;
     init();
+    refill();
+}
+
+std::unique_ptr<Scanner> Scanner::map_file(int fd)
+{
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return nullptr;
+    }
+
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    offset = offset < 0 || offset > st.st_size ? 0 : offset;
+    if(st.st_size == offset)
+    {
+        return std::make_unique<Scanner>(std::string());
+    }
+
+    void * data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    size_t size = st.st_size;
+    std::shared_ptr<const void> mapping(data, [size](const void * p) {
+        munmap(const_cast<void *>(p), size);
+    });
+
+    auto scanner = std::make_unique<Scanner>();
+    scanner->set_text(mapping, static_cast<const char *>(data) + offset, size - offset);
+    return scanner;
+}
+
+void Scanner::set_text(std::shared_ptr<const void> owner, const char * data, size_t size)
+{
+    source_text = std::move(owner);
+    text = data;
+    begin_pos = 0;
+    end_pos = size;
+}
+
+std::shared_ptr<const void> Scanner::source() const
+{
+    return source_text;
+}
+
+std::shared_ptr<const IdentifierTable> Scanner::identifiers() const
+{
+    return identifier_table;
+}
+
+bool Scanner::refill()
+{
+    if(stream == nullptr || !*stream)
+    {
+        return false;
+    }
+
+    // the bytes before the current token are never looked at again
+    content.erase(0, begin_pos);
+    end_pos -= begin_pos;
+    begin_pos = 0;
+
+    const size_t kept = content.size();
+    const size_t wanted = std::max(chunk_size, kept);
+    content.resize(kept + wanted);
+    stream->read(&content[kept], wanted);
+    content.resize(kept + stream->gcount());
+    text = content.data();
+    end_pos = content.size();
+
+    return content.size() > kept;
 }
 
 
@@ -50,6 +206,11 @@ void Scanner::init()
 {
     using Regex::RegexPatObj;
 
+#ifdef DRCC_DIRECT_SCANNER
+    // the tokens are compiled in
+    return ;
+#endif
+
     /// regex: [0-9]
     RegexPatObj pat_digits('0', '9');
 
@@ -62,18 +223,7 @@ void Scanner::init()
     /// regex: [a-zA-Z]
     RegexPatObj pat_letters = pat_lowercases | pat_uppercases;
 
-    // all the c tokens
-    add_tokenizer("int", INT);
-    add_tokenizer("main", MAIN);
-    add_tokenizer("void", VOID);
-    add_tokenizer("break", BREAK);
-    add_tokenizer("do", DO);
-    add_tokenizer("else", ELSE);
-    add_tokenizer("if", IF);
-    add_tokenizer("while", WHILE);
-    add_tokenizer("return", RETURN);
-    add_tokenizer("scanf", READ);
-    add_tokenizer("printf", WRITE);
+    // all the c tokens, but the keywords: words are classified by `keyword_type`
     add_tokenizer("{", LBRACE);
     add_tokenizer("}", RBRACE);
     add_tokenizer("[", LSQUARE);
@@ -115,11 +265,29 @@ void Scanner::init()
         ID
     );
 
-    end_pos = content.length();
+    // all the tokens share one automaton, reused from the previous run if unchanged
+    regexs.compile_cached(token_cache_path(), true);
+}
 
+int Scanner::match_token(const char * const str, int length, int & token_type, bool & truncated) const
+{
+#ifdef DRCC_DIRECT_SCANNER
+    return direct_scan(str, length, token_type, truncated);
+#else
+    return regexs.max_matched_lenghth(str, length, token_type, truncated);
+#endif
 }
 
-// the longest prefix in the buffer
+void Scanner::generate_direct_scanner(std::ostream & os) const
+{
+    os << "// generated by Scanner::generate_direct_scanner, do not edit\n\n";
+    os << "namespace DRCC\n{\n\n";
+    regexs.emit_direct_matcher(os, "direct_scan");
+    os << "\n}\n";
+}
+
+// the longest prefix in the buffer, in streaming mode a token running into the end of the
+// buffer is matched again after a refill
 Token Scanner::next_token()
 {
     // init
@@ -128,19 +296,44 @@ Token Scanner::next_token()
 
     while(ret_tok.token_type == NOTOK)
     {
-        // iterate through all regexs
-        for(const auto &item : regexs)
+        // whitespace never starts a token: skip the whole run at once
+        do
         {
-            int matched_len = item.first.max_matched_lenghth(content.c_str() + begin_pos, end_pos - begin_pos);
-            
-            // update only if longer
-            if(matched_len > max_length)
-            {
-                max_length = matched_len;
-                ret_tok.token_type = item.second;
-            }
+            begin_pos += span_whitespace(text + begin_pos, end_pos - begin_pos);
+        } while(begin_pos == end_pos && refill());
+
+        const char * const str = text + begin_pos;
+        const int length = end_pos - begin_pos;
+        const unsigned char first = length > 0 ? str[0] : 0;
+        int token_type = NOTOK;
+        bool truncated = false;
+
+        if((first | 0x20) >= 'a' && (first | 0x20) <= 'z')
+        {
+            // a word is an identifier unless it is exactly a keyword
+            max_length = span_word(str, length);
+            truncated = max_length == length;
+            token_type = keyword_type(std::string_view(str, max_length));
+        }
+        else if(first >= '0' && first <= '9' && ! (first == '0' && length > 1 && str[1] == 'x'))
+        {
+            // decimal literal, the hexadecimal ones are left to the automaton
+            max_length = span_digits(str, length);
+            truncated = max_length == length;
+            token_type = INT_NUM;
+        }
+        else
+        {
+            // the longest match over all regexs, ties go to the earlier added token
+            max_length = match_token(str, length, token_type, truncated);
         }
 
+        if(truncated && refill())
+        {
+            continue;
+        }
+        ret_tok.token_type = static_cast<TokenType>(token_type);
+
         if(ret_tok.token_type == NOTOK && empty())
         {
             ret_tok.token_type = END;
@@ -153,7 +346,13 @@ Token Scanner::next_token()
         }
         else
         {
-            ret_tok.lexeme = content.substr(begin_pos, max_length);
+            ret_tok.lexeme = lexemes != nullptr
+                ? lexemes->store(text + begin_pos, max_length)
+                : std::string_view(text + begin_pos, max_length);
+            if(ret_tok.token_type == ID)
+            {
+                ret_tok.symbol_id = identifier_table->intern(ret_tok.lexeme);
+            }
         }
 
         begin_pos += max_length;
@@ -162,9 +361,23 @@ Token Scanner::next_token()
 }
 
 
+size_t Scanner::next_tokens(Token * out, size_t max_tokens)
+{
+    size_t n = 0;
+    while(n < max_tokens)
+    {
+        out[n] = next_token();
+        if(out[n++].token_type == END)
+        {
+            break;
+        }
+    }
+    return n;
+}
+
 bool Scanner::empty()
 {
-    return end_pos - begin_pos <= 0;
+    return end_pos - begin_pos <= 0 && !refill();
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "scanner.h"
+
+#include <fstream>
+#include <iostream>
+
+// Writes the direct-coded scanner of the tokens defined in `Scanner::init`, see
+// `Scanner::generate_direct_scanner`. Usage: gen_scanner <output.cpp>
+using namespace DRCC;
+
+int main(int argc, char **argv)
+{
+    if(argc != 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <output.cpp>" << std::endl;
+        return 1;
+    }
+
+    std::ofstream fout(argv[1]);
+    if(!fout)
+    {
+        std::cerr << argv[0] << ": cannot write " << argv[1] << std::endl;
+        return 1;
+    }
+
+    // the automaton is always built here, never loaded from a cache
+    setenv("DRCC_TOKEN_CACHE", "", 1);
+    Scanner scanner{std::string()};
+    scanner.generate_direct_scanner(fout);
+
+    fout.close();
+    return fout ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+#include "parser.h"
+
+#include <fstream>
+#include <iostream>
+
+// Writes the LR(1) parsing tables of the C grammar as a C++ source, see
+// `Parser::generate_tables`. Usage: gen_tables <output.cpp>
+using namespace DRCC;
+
+int main(int argc, char **argv)
+{
+    if(argc != 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <output.cpp>" << std::endl;
+        return 1;
+    }
+
+    std::ofstream fout(argv[1]);
+    if(!fout)
+    {
+        std::cerr << argv[0] << ": cannot write " << argv[1] << std::endl;
+        return 1;
+    }
+
+    // the tables are built from the grammar, the scanner is never used
+    Parser parser(std::make_unique<Scanner>(std::string()));
+    parser.generate_tables(fout);
+
+    fout.close();
+    return fout ? 0 : 1;
+}